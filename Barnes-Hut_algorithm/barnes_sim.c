@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "barnes_sim.h"
+
+
+int rebuild(sim_t *sim);
+void accelerations(sim_t *sim);
+double refit_aux(sim_t *sim, node_t *root, double x0, double y0, int h, size_t *n_escaped);
+int in_cell(const sim_t *sim, double x, double y, double x0, double y0, int h);
+int in_universe(const sim_t *sim, size_t i);
+
+
+int sim_init(sim_t *sim, const body_t *bodies, const double *vx, const double *vy, size_t n, double s, double theta, double dt, double rebuild_fraction){
+	/*
+	initializes the simulation of the n bodies with initial
+	velocities (vx[i],vy[i]) (NULL for bodies at rest) in a universe
+	of radius s, builds the tree and calculates the first accelerations
+
+	returns 0 if the simulation was initialized succesfully
+	returns -1 otherwise
+	*/
+
+	memset(sim, 0, sizeof(sim_t));
+
+	sim->n = n;
+	sim->theta = theta;
+	sim->dt = dt;
+	sim->rebuild_fraction = rebuild_fraction;
+
+	sim->x = malloc(sizeof(double)*n);
+	sim->y = malloc(sizeof(double)*n);
+	sim->vx = malloc(sizeof(double)*n);
+	sim->vy = malloc(sizeof(double)*n);
+	sim->m = malloc(sizeof(double)*n);
+	sim->ax = malloc(sizeof(double)*n);
+	sim->ay = malloc(sizeof(double)*n);
+	sim->escaped = malloc(sizeof(size_t)*n);
+
+	if(sim->x == NULL || sim->y == NULL || sim->vx == NULL || sim->vy == NULL ||
+	   sim->m == NULL || sim->ax == NULL || sim->ay == NULL || sim->escaped == NULL){
+		sim_free(sim);
+		return -1;
+	}
+
+	for(size_t i=0; i<n; i++){
+		sim->x[i] = bodies[i].x;
+		sim->y[i] = bodies[i].y;
+		sim->m[i] = bodies[i].mass;
+		sim->vx[i] = (vx == NULL) ? 0 : vx[i];
+		sim->vy[i] = (vy == NULL) ? 0 : vy[i];
+	}
+
+	// the universe is grown by 'rebuild' until it holds all the bodies
+	if(s <= 0){
+		s = 1;
+		for(size_t i=0; i<n; i++){
+			if(fabs(sim->x[i]) > s) s = fabs(sim->x[i]);
+			if(fabs(sim->y[i]) > s) s = fabs(sim->y[i]);
+		}
+	}
+	
+	// a tree of N bodies takes about 2N nodes
+	tree_init(&sim->tree, s, 0, 0, 2*n);
+
+	if(rebuild(sim) != 0){
+		sim_free(sim);
+		return -1;
+	}
+
+	accelerations(sim);
+
+	return 0;
+}
+
+
+int sim_step(sim_t *sim){
+	/*
+	advances the bodies by one time step with the kick-drift-kick leapfrog
+
+	returns 0 if the step happened succesfully
+	returns -1 otherwise
+	*/
+
+	double dt = sim->dt;
+
+	// half kick with the old accelerations and drift
+	for(size_t i=0; i<sim->n; i++){
+		sim->vx[i] += 0.5*dt*sim->ax[i];
+		sim->vy[i] += 0.5*dt*sim->ay[i];
+		sim->x[i] += dt*sim->vx[i];
+		sim->y[i] += dt*sim->vy[i];
+	}
+
+	if(sim_refit(sim) != 0) return -1;
+
+	accelerations(sim);
+
+	// half kick with the new accelerations
+	for(size_t i=0; i<sim->n; i++){
+		sim->vx[i] += 0.5*dt*sim->ax[i];
+		sim->vy[i] += 0.5*dt*sim->ay[i];
+	}
+
+	sim->steps++;
+
+	return 0;
+}
+
+
+int sim_refit(sim_t *sim){
+	/*
+	updates the tree to the current positions, re-inserting only
+	the bodies that left their cell and rebuilding the whole tree
+	when too many bodies have been re-inserted
+
+	returns 0 if the tree was updated succesfully
+	returns -1 otherwise
+	*/
+
+	if(sim->tree.root == NULL) return rebuild(sim);
+
+	size_t n_escaped = 0;
+
+	refit_aux(sim, sim->tree.root, sim->tree.cx, sim->tree.cy, 1, &n_escaped);
+
+	sim->reinserted += n_escaped;
+
+	// the tree degraded too much, the old nodes are dropped all at once
+	if(sim->reinserted > sim->rebuild_fraction*sim->n) return rebuild(sim);
+
+	// a body left the universe, which has to grow
+	for(size_t k=0; k<n_escaped; k++){
+		if(!in_universe(sim, sim->escaped[k])) return rebuild(sim);
+	}
+
+	// the mass centers are up to date, so the insertions
+	// can update them along their path as usual
+	for(size_t k=0; k<n_escaped; k++){
+
+		size_t i = sim->escaped[k];
+
+		// a tree missing some bodies is dropped,
+		// the next refit builds it from scratch
+		if(tree_insert(&sim->tree, (long) i, sim->m[i], sim->x[i], sim->y[i]) != 0){
+			tree_reset(&sim->tree);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+double sim_energy(const sim_t *sim){
+	/*
+	total (kinetic plus potential) energy of the bodies, by direct summation
+	*/
+
+	double kinetic = 0;
+	double potential = 0;
+
+	#pragma omp parallel for schedule(dynamic, 64) reduction(+:kinetic,potential)
+	for(size_t i=0; i<sim->n; i++){
+
+		kinetic += 0.5*sim->m[i]*(sim->vx[i]*sim->vx[i] + sim->vy[i]*sim->vy[i]);
+
+		for(size_t j=i+1; j<sim->n; j++){
+			double d = sqrt(pow(sim->x[i]-sim->x[j], 2) + pow(sim->y[i]-sim->y[j], 2));
+			if(d > 0) potential -= G*sim->m[i]*sim->m[j]/d;
+		}
+	}
+
+	return kinetic + potential;
+}
+
+
+void sim_free(sim_t *sim){
+	/*
+	deallocates the simulation
+	*/
+
+	free(sim->x);
+	free(sim->y);
+	free(sim->vx);
+	free(sim->vy);
+	free(sim->m);
+	free(sim->ax);
+	free(sim->ay);
+	free(sim->escaped);
+	tree_free(&sim->tree);
+
+	memset(sim, 0, sizeof(sim_t));
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+int rebuild(sim_t *sim){
+	/*
+	builds the tree from scratch reusing the memory of the arena,
+	growing the universe if some body left it
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	tree_reset(&sim->tree);
+
+	// 'insert' can not separate bodies outside the universe,
+	// its radius is doubled until it holds all of them, which
+	// never happens for a body whose coordinates are not finite
+	// (or so far that the radius would overflow)
+	for(size_t i=0; i<sim->n; i++){
+
+		if(!isfinite(sim->x[i]) || !isfinite(sim->y[i])) return -1;
+
+		while(!in_universe(sim, i)){
+			if(!isfinite(2*sim->tree.s)) return -1;
+			tree_set_universe(&sim->tree, 2*sim->tree.s, sim->tree.cx, sim->tree.cy);
+		}
+	}
+
+	for(size_t i=0; i<sim->n; i++){
+		if(tree_insert(&sim->tree, (long) i, sim->m[i], sim->x[i], sim->y[i]) != 0){
+			tree_reset(&sim->tree);
+			return -1;
+		}
+	}
+
+	sim->reinserted = 0;
+	sim->rebuilds++;
+
+	return 0;
+}
+
+
+void accelerations(sim_t *sim){
+	/*
+	accelerations of all the bodies from the quadtree forces
+	*/
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t i=0; i<sim->n; i++){
+
+		double fx, fy;
+
+		tree_get_force(&sim->tree, sim->x[i], sim->y[i], sim->m[i], &fx, &fy, sim->theta);
+
+		sim->ax[i] = (sim->m[i] != 0) ? fx/sim->m[i] : 0;
+		sim->ay[i] = (sim->m[i] != 0) ? fy/sim->m[i] : 0;
+	}
+}
+
+
+double refit_aux(sim_t *sim, node_t *root, double x0, double y0, int h, size_t *n_escaped){
+	/*
+	refits recursively the node of geometrical center (x0,y0) at depth 'h'
+	(same convention of 'insert_aux') to the current positions
+
+	the bodies that left their leaf are removed from the tree and
+	appended to 'escaped', the empty nodes left behind are collapsed
+
+	returns the mass of the node
+	*/
+
+	if(root == NULL) return 0;
+
+	// leaf node
+	if(root->NE == NULL && root->SE == NULL && root->SW == NULL && root->NW == NULL){
+
+		if(root->id < 0) return 0;
+
+		size_t i = (size_t) root->id;
+
+		// the root is the whole universe, a body never leaves it
+		if(h > 1 && !in_cell(sim, sim->x[i], sim->y[i], x0, y0, h)){
+			sim->escaped[(*n_escaped)++] = i;
+			root->x = 0;
+			root->y = 0;
+			root->mass = 0;
+			root->id = -1;
+			return 0;
+		}
+
+		root->x = sim->x[i];
+		root->y = sim->y[i];
+		root->mass = sim->m[i];
+
+		return root->mass;
+	}
+
+	// central node, the children are refitted first
+	//
+	// radius of a subquadrant
+	double r = tree_node_size(&sim->tree, h);
+	node_t *children[4] = {root->NE, root->SE, root->SW, root->NW};
+
+	refit_aux(sim, root->NE, x0 + r, y0 + r, h+1, n_escaped);
+	refit_aux(sim, root->SE, x0 + r, y0 - r, h+1, n_escaped);
+	refit_aux(sim, root->SW, x0 - r, y0 - r, h+1, n_escaped);
+	refit_aux(sim, root->NW, x0 - r, y0 + r, h+1, n_escaped);
+
+	double mass = 0, mx = 0, my = 0;
+	int occupied = 0;
+	node_t *last = NULL;
+
+	for(int c=0; c<4; c++){
+		if(children[c] != NULL && children[c]->mass != 0){
+			mass += children[c]->mass;
+			mx += children[c]->mass*children[c]->x;
+			my += children[c]->mass*children[c]->y;
+			occupied++;
+			last = children[c];
+		}
+	}
+
+	// a single body left below the node: the node becomes its leaf again,
+	// as 'insert' would have built it (the nodes below stay in the arena
+	// until the next rebuild)
+	int single = (occupied == 1 && last->NE == NULL && last->SE == NULL && last->SW == NULL && last->NW == NULL);
+
+	if(occupied == 0 || single){
+		root->NE = NULL;
+		root->SE = NULL;
+		root->SW = NULL;
+		root->NW = NULL;
+		root->x = single ? last->x : 0;
+		root->y = single ? last->y : 0;
+		root->mass = single ? last->mass : 0;
+		root->id = single ? last->id : -1;
+		return root->mass;
+	}
+
+	root->mass = mass;
+	root->x = mx/mass;
+	root->y = my/mass;
+
+	return mass;
+}
+
+
+int in_cell(const sim_t *sim, double x, double y, double x0, double y0, int h){
+	/*
+	returns 1 if (x,y) is in the node of geometrical center (x0,y0)
+	at depth 'h' (same convention of 'insert_aux'), 0 otherwise
+
+	the borders follow 'get_quadrant': a body on a vertical border
+	belongs to the west quadrant, one on a horizontal border to the north one
+	*/
+
+	double r = tree_node_size(&sim->tree, h-1);
+
+	return (x > x0 - r && x <= x0 + r && y >= y0 - r && y < y0 + r);
+}
+
+
+int in_universe(const sim_t *sim, size_t i){
+	/*
+	returns 1 if the i-th body is inside the universe of the tree, 0 otherwise
+	*/
+
+	return (fabs(sim->x[i] - sim->tree.cx) < sim->tree.s && fabs(sim->y[i] - sim->tree.cy) < sim->tree.s);
+}
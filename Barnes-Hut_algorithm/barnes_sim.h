@@ -0,0 +1,87 @@
+#ifndef __BARNES_SIM__H
+#define __BARNES_SIM__H
+#include <stddef.h>
+#include "barnes_static.h"
+
+
+// time evolution of the N-body problem with the quadtree forces
+typedef struct sim {
+
+  // bodies: positions, velocities, masses and accelerations
+  size_t n;
+  double *x, *y;
+  double *vx, *vy;
+  double *m;
+  double *ax, *ay;
+
+  // quadtree of the current positions in a universe of its own,
+  // every leaf keeps the index of its body (see 'tree_insert')
+  tree_ctx_t tree;
+
+  // tollerance of the force and time step
+  double theta, dt;
+
+  // fraction of the bodies that can be re-inserted since
+  // the last rebuild before the tree is built again from scratch
+  double rebuild_fraction;
+
+  // bodies re-inserted since the last rebuild
+  size_t reinserted;
+
+  // bookkeeping of the steps done
+  size_t steps, rebuilds;
+
+  // work space for the bodies that left their cell
+  size_t *escaped;
+} sim_t;
+
+
+	/*
+	initializes the simulation of the n bodies with initial
+	velocities (vx[i],vy[i]) (NULL for bodies at rest) in a universe of
+	radius s centered in (0,0) (s <= 0 to fit the universe to the bodies),
+	builds the tree and calculates the first accelerations
+
+	returns 0 if the simulation was initialized succesfully
+	returns -1 otherwise
+	*/
+int sim_init (sim_t * sim, const body_t * bodies, const double * vx, const double * vy, size_t n, double s, double theta, double dt, double rebuild_fraction);
+
+
+	/*
+	advances the bodies by one time step with the kick-drift-kick
+	leapfrog, between the drift and the second kick the tree is
+	refitted to the new positions (see 'sim_refit')
+
+	returns 0 if the step happened succesfully
+	returns -1 otherwise
+	*/
+int sim_step (sim_t * sim);
+
+
+	/*
+	updates the tree to the current positions: the mass centers are
+	recomputed bottom-up and only the bodies that left the cell of their
+	leaf are removed and inserted again; the tree is built from scratch
+	when more than 'rebuild_fraction' of the bodies have been re-inserted
+	since the last rebuild, or when a body left the universe (whose
+	radius is then doubled until it holds all the bodies again)
+
+	returns 0 if the tree was updated succesfully
+	returns -1 otherwise (e.g. a body whose coordinates are not finite),
+	the tree is then emptied and the next call builds it from scratch
+	*/
+int sim_refit (sim_t * sim);
+
+
+	/*
+	total (kinetic plus potential) energy of the bodies, by direct summation
+	*/
+double sim_energy (const sim_t * sim);
+
+
+	/*
+	deallocates the simulation
+	*/
+void sim_free (sim_t * sim);
+#endif
@@ -1,17 +1,61 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "barnes_static.h"
+#include "pp_kernel.h"
 
-#define G 0.0000000000667 // gravitational coupling constant
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define BUILD_TASK_BODIES 4096 // bodies below which a subtree is built by a single task
+#define MIXED_BATCH 64 // interactions of a mixed precision walk summed at once by the kernels
+
+double _s;
+
+// context of the functions working on the global universe, following '_s'
+static tree_ctx_t universe;
+
+// interactions found by a mixed precision walk and not summed yet, the nodes
+// as single precision offsets from the body and the bodies in double precision
+typedef struct mixed_batch {
+  float dx[MIXED_BATCH], dy[MIXED_BATCH], fm[MIXED_BATCH];
+  int n_far;
+  double x[MIXED_BATCH], y[MIXED_BATCH], m[MIXED_BATCH];
+  int n_near;
+  double far[2], near[2];
+} mixed_batch_t;
+
+// counters of the walks of the thread and of all the threads
+_Thread_local walk_stats_t walk_counters;
+static walk_stats_t walk_totals;
 
 
 int get_quadrant(double x, double y, double x0, double y0);
-node_t *new_node(double x, double y, double m);
-node_t *insert_aux(double m, double x, double y, node_t *root, double x0, double y0, int h);
-double get_mass_aux(double x, double y, node_t *root, double x0, double y0, int h);
-void get_force_aux(double x, double y, double m, double *fx, double *fy, double theta, node_t* root, int h);
+node_t *new_node(double x, double y, double m, node_arena_t *arena);
+void new_children(node_t *children[4], node_arena_t *arena);
+node_t *arena_alloc(node_arena_t *arena, size_t k);
+void arena_push(node_arena_t *arena, node_block_t *b);
+node_t *insert_aux(const tree_ctx_t *ctx, double m, double x, double y, node_t *root, double x0, double y0, int h, node_arena_t *arena, long id);
+double get_mass_aux(const tree_ctx_t *ctx, double x, double y, node_t *root, double x0, double y0, int h);
+size_t get_force_aux(const tree_ctx_t *ctx, double x, double y, double m, double *fx, double *fy, double theta, node_t* root, int h);
 double l2_norm(double x1, double y1, double x2, double y2);
+node_t *build_parallel(const tree_ctx_t *ctx, const body_t *bodies, size_t n, node_arena_t *arena);
+void build_parallel_aux(const tree_ctx_t *ctx, const body_t *bodies, size_t *idx, size_t *tmp, size_t a, size_t b, node_t *root, double x0, double y0, int h, node_arena_t *local, int *failed);
+const tree_ctx_t *universe_ctx(void);
+int inside_universe(const tree_ctx_t *ctx, double x, double y);
+void fit_universe(const body_t *bodies, size_t n, double *s, double *cx, double *cy);
+void stats_aux(const node_t *root, int h, tree_stats_t *stats);
+size_t compact_count(const node_t *root);
+void compact_aux(const node_t *root, cnode_t *nodes, size_t k, size_t *next);
+double compact_node_size(const compact_tree_t *ct, int h);
+double compact_mass_aux(const compact_tree_t *ct, double x, double y, const cnode_t *node, double x0, double y0, int h);
+void compact_force_aux(const compact_tree_t *ct, double x, double y, double m, double *fx, double *fy, double theta, const cnode_t *node, int h);
+void compact_stats_aux(const compact_tree_t *ct, const cnode_t *node, int h, tree_stats_t *stats);
+void mixed_aux(const compact_tree_t *ct, size_t k, double x0, double y0, int h);
+void mixed_force_aux(const compact_tree_t *ct, double x, double y, const float *open, size_t k, double x0, double y0, int h, mixed_batch_t *batch);
+void mixed_flush(double x, double y, mixed_batch_t *batch);
 
 
 int string_to_body(const char* s, double* x, double* y, double* m){
@@ -50,6 +94,8 @@ node_t* insert(double m, double x, double y, node_t *root){
 	with root pointed by 'root'
 	
 	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
 	*/
 	
 	
@@ -59,11 +105,59 @@ node_t* insert(double m, double x, double y, node_t *root){
 	
 	// empty root, first body to be inserted in the quadtree
 	if(root == NULL){
-		root = new_node(x,y,m);
+		root = new_node(x,y,m,NULL);
+		return root;
+	}  
+
+	return insert_aux(universe_ctx(),m,x,y,root,x0,y0,h,NULL,-1);
+}
+
+
+node_t* insert_arena(double m, double x, double y, node_t *root, node_arena_t *arena){
+	/*
+	same as 'insert' but the nodes are taken from 'arena'
+	
+	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
+	*/
+	
+	
+	int h = 1;
+	double x0 = 0; 
+	double y0 = 0;
+	
+	if(root == NULL){
+		root = new_node(x,y,m,arena);
+		return root;
+	}  
+
+	return insert_aux(universe_ctx(),m,x,y,root,x0,y0,h,arena,-1);
+}
+
+
+node_t* insert_indexed(long id, double m, double x, double y, node_t *root, node_arena_t *arena){
+	/*
+	same as 'insert_arena' but the leaf of the body keeps
+	the index 'id' of the body
+	
+	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
+	*/
+	
+	
+	int h = 1;
+	double x0 = 0; 
+	double y0 = 0;
+	
+	if(root == NULL){
+		root = new_node(x,y,m,arena);
+		if(root != NULL) root->id = id;
 		return root;
 	}  
 
-	return insert_aux(m,x,y,root,x0,y0,h);
+	return insert_aux(universe_ctx(),m,x,y,root,x0,y0,h,arena,id);
 }
 
 
@@ -82,6 +176,94 @@ void free_tree (node_t * root){
 }
 
 
+void arena_init(node_arena_t *arena, size_t block_nodes){
+	/*
+	initializes an empty arena, the first block holds 'block_nodes'
+	nodes and every new block doubles the size of the previous one
+	*/
+	
+	// a split takes 4 nodes at once from the same block
+	if(block_nodes < 4) block_nodes = 4;
+	
+	arena->head = NULL;
+	arena->cur = NULL;
+	arena->block_nodes = block_nodes;
+}
+
+
+void arena_reset(node_arena_t *arena){
+	/*
+	makes all the nodes of the arena available again in O(1),
+	the blocks are kept for the next tree
+	*/
+	
+	// the following blocks are emptied lazily by 'arena_alloc'
+	// when it moves on to them
+	arena->cur = arena->head;
+	if(arena->cur != NULL) arena->cur->used = 0;
+}
+
+
+void arena_free(node_arena_t *arena){
+	/*
+	releases all the blocks of the arena, and so every tree built in it
+	*/
+	
+	node_block_t *b = arena->head;
+	
+	while(b != NULL){
+		node_block_t *next = b->next;
+		free(b);
+		b = next;
+	}
+	
+	arena->head = NULL;
+	arena->cur = NULL;
+}
+
+
+void arena_merge(node_arena_t *dst, node_arena_t *src){
+	/*
+	moves all the blocks of 'src' into 'dst', so the trees built in 'src'
+	are released along with 'dst'; 'src' is left empty
+	*/
+	
+	if(src->head == NULL) return;
+	
+	// blocks not handed out yet, after the current one, 
+	// are queued behind the current block of 'src'
+	node_block_t *spare = (dst->cur == NULL) ? NULL : dst->cur->next;
+	node_block_t *last = src->cur;
+	
+	while(last->next != NULL){
+		last = last->next;
+	}
+	last->next = spare;
+	
+	if(dst->cur == NULL) dst->head = src->head;
+		else dst->cur->next = src->head;
+	
+	dst->cur = src->cur;
+	
+	src->head = NULL;
+	src->cur = NULL;
+}
+
+
+node_t* insert_parallel(const body_t *bodies, size_t n, node_arena_t *arena){
+	/*
+	builds the quad tree of the n bodies in parallel, the result being
+	the same of inserting them one after the other with 'insert_indexed'
+	(bodies[i] having index i)
+	
+	returns the pointer to the tree
+	returns NULL if n = 0 or the allocation failed
+	*/
+	
+	return build_parallel(universe_ctx(), bodies, n, arena);
+}
+
+
 double get_mass(double x, double y, node_t* root){
 	/*
 	returns mass of the body in (x,y)
@@ -99,7 +281,7 @@ double get_mass(double x, double y, node_t* root){
 	int h = 1;
 	
 	
-	return get_mass_aux(x,y,root,x0,y0,h);
+	return get_mass_aux(universe_ctx(),x,y,root,x0,y0,h);
 	
 }
 
@@ -121,265 +303,1399 @@ void get_force(double x, double y, double *fx, double *fy, double theta, node_t*
 	
 	if(m == 0) return ;
 	
-	get_force_aux(x,y,m,fx,fy,theta,root,h);
+	WALK_COUNT(walks, 1);
+	get_force_aux(universe_ctx(),x,y,m,fx,fy,theta,root,h);
+	WALK_FLUSH();
 	
 	return;
 }
 
 
-////////////////////...UTILITY FUNCTIONS...////////////////////////////////
-int get_quadrant(double x, double y, double x0, double y0){
+void get_force_body(double x, double y, double m, double *fx, double *fy, double theta, node_t* root){
 	/*
-	returns the right subquadrant where to insert the body
-	based on the body coordinates (x,y) and the current 
-	quadrant's coordinates (x0,y0)
+	same as 'get_force' for a body of known mass m, skipping the lookup
+	*/
 	
-	e.g. if the whole space has radius 1 and is subdivided
-	into 4 quadrants, the NE quadrant will have center 
-	coordinates (0.5,0.5)
 	
+	*fx = 0;
+	*fy = 0;
 	
-	return 1 for NE quadrant
-	return 2 for SE quadrant
-	return 3 for SW quadrant
-	return 4 for NW quadrant
+	if(root == NULL || m == 0) return;
+	
+	WALK_COUNT(walks, 1);
+	get_force_aux(universe_ctx(),x,y,m,fx,fy,theta,root,0);
+	WALK_FLUSH();
+}
+
+
+void tree_init(tree_ctx_t *ctx, double s, double cx, double cy, size_t block_nodes){
+	/*
+	initializes an empty tree in the universe of radius s and
+	geometrical center (cx,cy)
 	*/
+	
+	arena_init(&ctx->arena, block_nodes);
+	ctx->root = NULL;
+	ctx->next_id = 0;
+	
+	tree_set_universe(ctx, s, cx, cy);
+}
 
 
-	if(x > x0){
-		if(y >= y0){
-			return 1;
-		}
-		else return 2;
-	}
+void tree_set_universe(tree_ctx_t *ctx, double s, double cx, double cy){
+	/*
+	moves the tree to the universe of radius s and geometrical center (cx,cy)
+	*/
 	
-	else{
-		if(y < y0){
-			return 3;
-		}
-		else return 4;
+	ctx->s = s;
+	ctx->cx = cx;
+	ctx->cy = cy;
+	
+	// the same values of s/pow(2,h), the division by a power of 2 being exact
+	for(int h=0; h<TREE_LEVELS; h++){
+		ctx->size[h] = ldexp(s, -h);
 	}
 }
 
 
-node_t *new_node(double x, double y, double m){
+void tree_reset(tree_ctx_t *ctx){
 	/*
-	initializes a node
+	empties the tree in O(1), the nodes are kept for the next one
 	*/
 	
-	node_t *temp;
-	temp = malloc(sizeof(node_t));
-	if(temp == NULL) return NULL;
-	
-	temp -> x = x;
-	temp -> y = y;
-	temp -> mass = m;
-	temp -> NW = NULL;
-	temp -> NE = NULL;
-	temp -> SE = NULL;
-	temp -> SW = NULL;
+	arena_reset(&ctx->arena);
+	ctx->root = NULL;
+	ctx->next_id = 0;
+}
+
+
+void tree_free(tree_ctx_t *ctx){
+	/*
+	deallocates the nodes of the tree
+	*/
 	
-	return temp;
+	arena_free(&ctx->arena);
+	ctx->root = NULL;
+	ctx->next_id = 0;
 }
 
 
-node_t *insert_aux(double m, double x, double y, node_t *root, double x0, double y0, int h){
+double tree_node_size(const tree_ctx_t *ctx, int h){
 	/*
-	insert a body recursively keeping track of the current quadrant's gemetrical center
-	(not mass center) (x0,y0) and of the depth in the tree, given by 'h' 
+	returns the radius of a node at depth h of the tree
 	*/
 	
+	if(h < TREE_LEVELS) return ctx->size[h];
 	
-	// empty leaf, just insert the body
-	if(root -> mass == 0){
-		root = new_node(x,y,m);
-		return root;
-	}
+	return ldexp(ctx->s, -h);
+}
+
+
+int tree_insert(tree_ctx_t *ctx, long id, double m, double x, double y){
+	/*
+	same as 'insert_indexed' for the tree of the context
 	
+	returns 0 if the body was inserted succesfully
+	returns -1 if the body is outside the universe or the allocation failed
+	*/
 	
-	// leaf with a body in it
-	//
-	// from the leaf node another 4 quadrants are produced and 
-	// the old body is placed in the right quadrant
-	//
-	// the insertion of the new body then proceeds recursively
-	// with the case of central node
-	if((root->NW) == NULL && (root->NE) == NULL && (root->SW) == NULL && (root->SE) == NULL){
-		
-		node_t *temp = new_node(root->x,root->y,root->mass);
-		
-		int pos = get_quadrant(temp->x,temp->y,x0,y0);
-		
-		if(pos == 1){
-			
-			// the old body is assigned to the right quadrant
-			// and the other quadrant are inizialized with arbitrary 0 values
-			root->NE = temp;
-			root->SE = new_node(0,0,0);
-			root->SW = new_node(0,0,0);
-			root->NW = new_node(0,0,0);
-		}
-		
-		else if(pos == 2){
-			root->NE = new_node(0,0,0);
-			root->SE = temp;
-			root->SW = new_node(0,0,0);
-			root->NW = new_node(0,0,0);
-		}
-		
-		else if(pos == 3){
-			root->NE = new_node(0,0,0);
-			root->SE = new_node(0,0,0);
-			root->SW = temp;
-			root->NW = new_node(0,0,0);
-		}
-		
-		else if(pos == 4){
-			root->NE = new_node(0,0,0);
-			root->SE = new_node(0,0,0);
-			root->SW = new_node(0,0,0);
-			root->NW = temp;
-		}
+	// a body outside the universe could never be separated from the others
+	if(!inside_universe(ctx,x,y)) return -1;
+	
+	if(ctx->root == NULL){
+		ctx->root = new_node(x,y,m,&ctx->arena);
+		if(ctx->root == NULL) return -1;
+		ctx->root->id = id;
 	}
 	
+	else if(insert_aux(ctx,m,x,y,ctx->root,ctx->cx,ctx->cy,1,&ctx->arena,id) == NULL) return -1;
 	
-	// central node (it has at least a child node)
-	// continue to search recursively for an empty leaf
-	// deepening the search in the right quadrants depending
-	// on the coordinates of the body to be inserted
-	int pos = get_quadrant(x,y,x0,y0);
-		
-	if(pos == 1){
-			
-		//center of the new quadrant
-		x0 += _s/pow(2,h);
-		y0 += _s/pow(2,h);
-			
-		// insertion proceeds recursively in the new quadrant
-		root->NE = insert_aux(m,x,y,root->NE,x0,y0,h+1);
-	}
-		
-	else if(pos == 2){
-		x0 += _s/pow(2,h);
-		y0 -= _s/pow(2,h);
-		root->SE = insert_aux(m,x,y,root->SE,x0,y0,h+1);
-	}
-		
-	else if(pos == 3){
-		x0 -= _s/pow(2,h);
-		y0 -= _s/pow(2,h);
-		root->SW = insert_aux(m,x,y,root->SW,x0,y0,h+1);
-	}
-		
-	else if(pos == 4){
-		x0 -= _s/pow(2,h);
-		y0 += _s/pow(2,h);
-		root->NW = insert_aux(m,x,y,root->NW,x0,y0,h+1);
-	}
-		
-	// node's mass and mass center update
-	root->x += x*m/(root->mass);
-	root->x *= (root->mass)/(root->mass+m);
-	root->y += y*m/(root->mass);
-	root->y *= (root->mass)/(root->mass+m);
-	root->mass += m;
+	if(id >= ctx->next_id) ctx->next_id = id + 1;
 	
-	return root;
+	return 0;
 }
 
 
-double get_mass_aux(double x, double y,node_t *root, double x0, double y0, int h){
-
-	
-	if(root == NULL) return 0;
+int tree_build(tree_ctx_t *ctx, const body_t *bodies, size_t n){
+	/*
+	same as 'insert_parallel' for the tree of the context, the n bodies
+	are added to the ones already in it with the ids following them
 	
-	// check if the node is indeed a lead (i.e. a body and not a mass center)
-	if(root -> NW == NULL && root -> NE == NULL && root -> SE == NULL && root -> SW == NULL){
+	returns 0 if the bodies were inserted succesfully
+	returns -1 if a body is outside the universe or the allocation failed
+	*/
 	
-		if(root->x == x && root->y == y) return root->mass;
-		
-		return 0;
+	for(size_t i=0; i<n; i++){
+		if(!inside_universe(ctx,bodies[i].x,bodies[i].y)) return -1;
 	}
 	
-	// binary-like search in the appropriate quadrant
-	int pos = get_quadrant(x,y,x0,y0);
-	
-	if(pos==1){
+	if(n == 0) return 0;
 	
-		// center of the next subquadrant
-		//
-		// universe_radius/pow(2,h) is the radius of a subquadrant 
-		// of a node at depth 'h' in the quadtree
-		x0 += _s/pow(2,h);  
-		y0 += _s/pow(2,h);
-		
-		// search in the next subquadrant
-		return get_mass_aux(x,y,root->NE,x0,y0,h+1);
+	// a tree not empty grows one body at a time, the ids
+	// going on from the largest one already in the tree
+	if(ctx->root != NULL){
+		for(size_t i=0; i<n; i++){
+			if(tree_insert(ctx,ctx->next_id,bodies[i].mass,bodies[i].x,bodies[i].y) != 0) return -1;
+		}
+		return 0;
 	}
 	
-	else if(pos==2){
-		x0 += _s/pow(2,h);
-		y0 -= _s/pow(2,h);
-		return get_mass_aux(x,y,root->SE,x0,y0,h+1);
-	}
+	ctx->root = build_parallel(ctx, bodies, n, &ctx->arena);
 	
-	else if(pos==3){
-		x0 -= _s/pow(2,h);
-		y0 -= _s/pow(2,h);
-		return get_mass_aux(x,y,root->SW,x0,y0,h+1);
-	}
+	if(ctx->root == NULL) return -1;
 	
-	else if(pos==4){
-		x0 -= _s/pow(2,h);
-		y0 += _s/pow(2,h);
-		return get_mass_aux(x,y,root->NW,x0,y0,h+1);
-	}
+	ctx->next_id = (long) n;
 	
-	return 0;		
+	return 0;
 }
 
 
-void get_force_aux(double x, double y, double m, double *fx, double *fy, double theta, node_t* root, int h){
+double tree_get_mass(const tree_ctx_t *ctx, double x, double y){
 	/*
-	calculates recursively the force following the barnes-hut approximation depending on the tollerance 'theta'
+	same as 'get_mass' for the tree of the context
 	*/
 	
+	node_t *root = ctx->root;
 	
-	// invalid node
-	if(root -> mass == 0 || (root -> x == x && root -> y == y)) return;
+	if(root == NULL) return 0;
 	
-	double d = l2_norm(x,y,root->x,root->y);
-	double size = _s/pow(2,h); // size of the current quadrant
+	if(root->x == x && root->y == y) return root->mass;
 	
+	return get_mass_aux(ctx,x,y,root,ctx->cx,ctx->cy,1);
+}
+
+
+size_t tree_get_force(const tree_ctx_t *ctx, double x, double y, double m, double *fx, double *fy, double theta){
+	/*
+	same as 'get_force_body' for the tree of the context
 	
-	// the node's mass center is far enough from the  body
-	// to be considered a single point
-	// or we arrived to a leaf node
-	if(size/d < theta || (root -> NW == NULL && root -> NE == NULL && root -> SE == NULL && root -> SW == NULL)){
-		
-		double Dx = root->x - x;
-		double Dy = root->y - y;
-		double f = G*m*(root->mass)/pow(d,2); // modulus of the force
-		
-		// force components
-		*fx += f*Dx/d;
-		*fy += f*Dy/d;
-		
-		return;
-	}
+	returns the number of interactions of the walk
+	*/
 	
-	get_force_aux(x, y, m, fx, fy, theta, root->NE, h+1);
-	get_force_aux(x, y, m, fx, fy, theta, root->SE, h+1);
-	get_force_aux(x, y, m, fx, fy, theta, root->SW, h+1);
-	get_force_aux(x, y, m, fx, fy, theta, root->NW, h+1);
-
+	*fx = 0;
+	*fy = 0;
+	
+	if(ctx->root == NULL || m == 0) return 0;
+	
+	WALK_COUNT(walks, 1);
+	size_t count = get_force_aux(ctx,x,y,m,fx,fy,theta,ctx->root,0);
+	WALK_FLUSH();
+	
+	return count;
 }
 
 
-double l2_norm(double x1, double y1, double x2, double y2){
+void tree_stats(const node_t *root, tree_stats_t *stats){
 	/*
-	L2 distance between (x1,y1) and (x2,y2) vectors
+	shape and memory of the tree pointed by 'root'
 	*/
 	
-	return sqrt(pow(x1-x2, 2) + pow(y1-y2, 2));
+	memset(stats, 0, sizeof(tree_stats_t));
+	
+	stats_aux(root, 0, stats);
+	
+	stats->bytes = stats->nodes*sizeof(node_t);
+}
+
+
+size_t arena_bytes(const node_arena_t *arena){
+	/*
+	returns the memory reserved by the blocks of the arena in bytes
+	*/
+	
+	size_t bytes = 0;
+	
+	for(const node_block_t *b=arena->head; b!=NULL; b=b->next){
+		bytes += sizeof(node_block_t) + b->cap*sizeof(node_t);
+	}
+	
+	return bytes;
+}
+
+
+void walk_stats_reset(void){
+	/*
+	sets to 0 the counters of the force walks
+	*/
+	
+	#pragma omp critical(walk_stats)
+	memset(&walk_totals, 0, sizeof(walk_stats_t));
+}
+
+
+void walk_stats_read(walk_stats_t *stats){
+	/*
+	reads the counters of the force walks done by all the threads
+	*/
+	
+	#pragma omp critical(walk_stats)
+	*stats = walk_totals;
+}
+
+
+void walk_stats_flush(void){
+	/*
+	adds the counts of the calling thread to the global counters
+	*/
+	
+	#pragma omp atomic
+	walk_totals.walks += walk_counters.walks;
+	#pragma omp atomic
+	walk_totals.visited += walk_counters.visited;
+	#pragma omp atomic
+	walk_totals.accepted += walk_counters.accepted;
+	#pragma omp atomic
+	walk_totals.leaf += walk_counters.leaf;
+	
+	memset(&walk_counters, 0, sizeof(walk_stats_t));
+}
+
+
+int forces_batch(problem_t *problems, size_t count){
+	/*
+	calculates the forces of 'count' independent problems, every
+	thread working on its problems in a context of its own
+	
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+	
+	int failed = 0;
+	
+	#pragma omp parallel
+	{
+		tree_ctx_t ctx;
+		tree_init(&ctx, 1, 0, 0, 1024);
+		
+		// problems may differ a lot in size, so they are handed out one by one
+		#pragma omp for schedule(dynamic, 1)
+		for(size_t k=0; k<count; k++){
+			
+			problem_t *p = problems + k;
+			double s = p->s, cx = p->cx, cy = p->cy;
+			
+			if(s <= 0) fit_universe(p->bodies, p->n, &s, &cx, &cy);
+			
+			tree_reset(&ctx);
+			tree_set_universe(&ctx, s, cx, cy);
+			
+			if(tree_build(&ctx, p->bodies, p->n) != 0){
+				#pragma omp atomic write
+				failed = 1;
+				continue;
+			}
+			
+			for(size_t i=0; i<p->n; i++){
+				const body_t *b = p->bodies + i;
+				tree_get_force(&ctx, b->x, b->y, b->mass, &p->fx[i], &p->fy[i], p->theta);
+			}
+		}
+		
+		tree_free(&ctx);
+	}
+	
+	if(failed) return -1;
+	
+	return 0;
+}
+
+
+int tree_compact(const tree_ctx_t *ctx, compact_tree_t *ct){
+	/*
+	copies the tree of the context in 'ct' leaving out the empty quadrants
+	
+	returns 0 if the tree was copied succesfully
+	returns -1 otherwise
+	*/
+	
+	ct->s = ctx->s;
+	ct->cx = ctx->cx;
+	ct->cy = ctx->cy;
+	memcpy(ct->size, ctx->size, sizeof(ct->size));
+	
+	ct->nodes = NULL;
+	ct->n_nodes = 0;
+	ct->fnodes = NULL;
+	
+	if(ctx->root == NULL || ctx->root->mass == 0) return 0;
+	
+	size_t count = compact_count(ctx->root);
+	
+	// the children are addressed by a 32 bits index
+	if(count > UINT32_MAX) return -1;
+	
+	ct->nodes = malloc(sizeof(cnode_t)*count);
+	if(ct->nodes == NULL) return -1;
+	
+	size_t next = 1;
+	compact_aux(ctx->root, ct->nodes, 0, &next);
+	
+	ct->n_nodes = count;
+	
+	return 0;
+}
+
+
+void compact_free(compact_tree_t *ct){
+	/*
+	deallocates the nodes of the compact tree
+	*/
+	
+	free(ct->nodes);
+	free(ct->fnodes);
+	ct->nodes = NULL;
+	ct->fnodes = NULL;
+	ct->n_nodes = 0;
+}
+
+
+double compact_get_mass(const compact_tree_t *ct, double x, double y){
+	/*
+	same as 'tree_get_mass' for the compact tree
+	*/
+	
+	if(ct->n_nodes == 0) return 0;
+	
+	return compact_mass_aux(ct,x,y,ct->nodes,ct->cx,ct->cy,1);
+}
+
+
+void compact_get_force(const compact_tree_t *ct, double x, double y, double m, double *fx, double *fy, double theta){
+	/*
+	same as 'tree_get_force' for the compact tree
+	*/
+	
+	*fx = 0;
+	*fy = 0;
+	
+	if(ct->n_nodes == 0 || m == 0) return;
+	
+	WALK_COUNT(walks, 1);
+	compact_force_aux(ct,x,y,m,fx,fy,theta,ct->nodes,0);
+	WALK_FLUSH();
+}
+
+
+int compact_mixed(compact_tree_t *ct){
+	/*
+	makes the single precision copy of the nodes
+	
+	returns 0 if the copy was made succesfully
+	returns -1 otherwise
+	*/
+	
+	if(ct->n_nodes == 0) return 0;
+	
+	if(ct->fnodes == NULL) ct->fnodes = malloc(sizeof(cnodef_t)*ct->n_nodes);
+	if(ct->fnodes == NULL) return -1;
+	
+	mixed_aux(ct, 0, ct->cx, ct->cy, 0);
+	
+	return 0;
+}
+
+
+void compact_get_force_mixed(const compact_tree_t *ct, double x, double y, double m, double *fx, double *fy, double theta){
+	/*
+	same as 'compact_get_force' in mixed precision
+	*/
+	
+	if(ct->fnodes == NULL){
+		compact_get_force(ct,x,y,m,fx,fy,theta);
+		return;
+	}
+	
+	*fx = 0;
+	*fy = 0;
+	
+	if(ct->n_nodes == 0 || m == 0) return;
+	
+	mixed_batch_t batch;
+	
+	batch.n_far = batch.n_near = 0;
+	batch.far[0] = batch.far[1] = 0;
+	batch.near[0] = batch.near[1] = 0;
+	
+	// a node at depth h is taken as a single point if the square of its
+	// distance is more than open[h] = (size/theta)^2, i.e. size/d < theta,
+	// the lengths being in units of the radius of the universe
+	float open[TREE_LEVELS];
+	
+	for(int h=0; h<TREE_LEVELS; h++){
+		double size = ct->size[h]/ct->s;
+		open[h] = (float) (size*size/(theta*theta));
+	}
+	
+	WALK_COUNT(walks, 1);
+	mixed_force_aux(ct,x,y,open,0,ct->cx,ct->cy,0,&batch);
+	mixed_flush(x,y,&batch);
+	WALK_FLUSH();
+	
+	// the masses of the nodes are fractions of the total mass and
+	// their distances are in units of the radius of the universe
+	double far = ct->nodes[0].mass/(ct->s*ct->s);
+	
+	*fx = G*m*(batch.near[0] + far*batch.far[0]);
+	*fy = G*m*(batch.near[1] + far*batch.far[1]);
+}
+
+
+void compact_stats(const compact_tree_t *ct, tree_stats_t *stats){
+	/*
+	same as 'tree_stats' for the compact tree
+	*/
+	
+	memset(stats, 0, sizeof(tree_stats_t));
+	
+	if(ct->n_nodes > 0) compact_stats_aux(ct, ct->nodes, 0, stats);
+	
+	stats->bytes = ct->n_nodes*sizeof(cnode_t);
+	if(ct->fnodes != NULL) stats->bytes += ct->n_nodes*sizeof(cnodef_t);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+int get_quadrant(double x, double y, double x0, double y0){
+	/*
+	returns the right subquadrant where to insert the body
+	based on the body coordinates (x,y) and the current 
+	quadrant's coordinates (x0,y0)
+	
+	e.g. if the whole space has radius 1 and is subdivided
+	into 4 quadrants, the NE quadrant will have center 
+	coordinates (0.5,0.5)
+	
+	
+	return 1 for NE quadrant
+	return 2 for SE quadrant
+	return 3 for SW quadrant
+	return 4 for NW quadrant
+	*/
+
+
+	if(x > x0){
+		if(y >= y0){
+			return 1;
+		}
+		else return 2;
+	}
+	
+	else{
+		if(y < y0){
+			return 3;
+		}
+		else return 4;
+	}
+}
+
+
+node_t *arena_alloc(node_arena_t *arena, size_t k){
+	/*
+	returns 'k' contiguous uninitialized nodes from the arena
+	
+	returns NULL if a new block could not be allocated
+	*/
+	
+	node_block_t *b = arena->cur;
+	
+	if(b != NULL && b->used + k <= b->cap){
+		b->used += k;
+		return b->nodes + b->used - k;
+	}
+	
+	// block already allocated before the last reset
+	if(b != NULL && b->next != NULL){
+		b = b->next;
+		b->used = 0;
+	}
+	
+	else{
+		size_t cap = (b == NULL) ? arena->block_nodes : 2*b->cap;
+		
+		node_block_t *temp = malloc(sizeof(node_block_t) + cap*sizeof(node_t));
+		if(temp == NULL) return NULL;
+		
+		temp->next = NULL;
+		temp->cap = cap;
+		temp->used = 0;
+		
+		if(b == NULL) arena->head = temp;
+			else b->next = temp;
+		
+		b = temp;
+	}
+	
+	arena->cur = b;
+	b->used = k;
+	
+	return b->nodes;
+}
+
+
+void arena_push(node_arena_t *arena, node_block_t *b){
+	/*
+	appends the empty block b to the arena, after the
+	blocks already there, to be handed out when they are full
+	*/
+	
+	b->next = NULL;
+	b->used = 0;
+	
+	if(arena->head == NULL){
+		arena->head = b;
+		arena->cur = b;
+		return;
+	}
+	
+	node_block_t *last = arena->cur;
+	
+	while(last->next != NULL){
+		last = last->next;
+	}
+	
+	last->next = b;
+}
+
+
+node_t *new_node(double x, double y, double m, node_arena_t *arena){
+	/*
+	initializes a node, taken from 'arena' or
+	allocated on its own if 'arena' is NULL
+	*/
+	
+	node_t *temp;
+	
+	if(arena == NULL) temp = malloc(sizeof(node_t));
+		else temp = arena_alloc(arena, 1);
+	
+	if(temp == NULL) return NULL;
+	
+	temp -> x = x;
+	temp -> y = y;
+	temp -> mass = m;
+	temp -> id = -1;
+	temp -> NW = NULL;
+	temp -> NE = NULL;
+	temp -> SE = NULL;
+	temp -> SW = NULL;
+	
+	return temp;
+}
+
+
+void new_children(node_t *children[4], node_arena_t *arena){
+	/*
+	initializes the 4 empty quadrants of a node being split
+	in the order NE, SE, SW, NW
+	
+	with an arena the 4 nodes are contiguous in memory, so the 
+	force walk visiting them one after the other stays on few cache lines
+	*/
+	
+	if(arena == NULL){
+		for(int i=0; i<4; i++){
+			children[i] = new_node(0,0,0,NULL);
+		}
+		return;
+	}
+	
+	node_t *block = arena_alloc(arena, 4);
+	
+	for(int i=0; i<4; i++){
+		
+		if(block == NULL){
+			children[i] = NULL;
+			continue;
+		}
+		
+		children[i] = block + i;
+		children[i] -> x = 0;
+		children[i] -> y = 0;
+		children[i] -> mass = 0;
+		children[i] -> id = -1;
+		children[i] -> NW = NULL;
+		children[i] -> NE = NULL;
+		children[i] -> SE = NULL;
+		children[i] -> SW = NULL;
+	}
+}
+
+
+node_t *insert_aux(const tree_ctx_t *ctx, double m, double x, double y, node_t *root, double x0, double y0, int h, node_arena_t *arena, long id){
+	/*
+	insert a body recursively keeping track of the current quadrant's gemetrical center
+	(not mass center) (x0,y0) and of the depth in the tree, given by 'h' 
+	
+	the leaf where the body ends up keeps its index 'id'
+	
+	returns NULL if the allocation of a split failed, the tree
+	keeping the bodies it had before the insertion
+	*/
+	
+	
+	// empty leaf, just insert the body
+	//
+	// the placeholder node is reused so it does not get lost
+	if(root -> mass == 0){
+		root -> x = x;
+		root -> y = y;
+		root -> mass = m;
+		root -> id = id;
+		return root;
+	}
+	
+	
+	// leaf with a body in it
+	//
+	// from the leaf node another 4 quadrants are produced and 
+	// the old body is placed in the right quadrant
+	//
+	// the insertion of the new body then proceeds recursively
+	// with the case of central node
+	if((root->NW) == NULL && (root->NE) == NULL && (root->SW) == NULL && (root->SE) == NULL){
+		
+		// the 4 quadrants are inizialized with arbitrary 0 values
+		// and the old body is assigned to the right one
+		node_t *children[4];
+		new_children(children, arena);
+		
+		if(children[0] == NULL || children[1] == NULL || children[2] == NULL || children[3] == NULL){
+			
+			// nodes of an arena go back with its next reset
+			if(arena == NULL){
+				for(int i=0; i<4; i++){
+					free(children[i]);
+				}
+			}
+			return NULL;
+		}
+		
+		int pos = get_quadrant(root->x,root->y,x0,y0);
+		
+		children[pos-1] -> x = root->x;
+		children[pos-1] -> y = root->y;
+		children[pos-1] -> mass = root->mass;
+		children[pos-1] -> id = root->id;
+		root -> id = -1;
+		
+		root->NE = children[0];
+		root->SE = children[1];
+		root->SW = children[2];
+		root->NW = children[3];
+	}
+	
+	
+	// central node (it has at least a child node)
+	// continue to search recursively for an empty leaf
+	// deepening the search in the right quadrants depending
+	// on the coordinates of the body to be inserted
+	int pos = get_quadrant(x,y,x0,y0);
+	node_t *leaf = NULL;
+		
+	if(pos == 1){
+			
+		//center of the new quadrant
+		x0 += tree_node_size(ctx,h);
+		y0 += tree_node_size(ctx,h);
+			
+		// insertion proceeds recursively in the new quadrant
+		leaf = insert_aux(ctx,m,x,y,root->NE,x0,y0,h+1,arena,id);
+	}
+		
+	else if(pos == 2){
+		x0 += tree_node_size(ctx,h);
+		y0 -= tree_node_size(ctx,h);
+		leaf = insert_aux(ctx,m,x,y,root->SE,x0,y0,h+1,arena,id);
+	}
+		
+	else if(pos == 3){
+		x0 -= tree_node_size(ctx,h);
+		y0 -= tree_node_size(ctx,h);
+		leaf = insert_aux(ctx,m,x,y,root->SW,x0,y0,h+1,arena,id);
+	}
+		
+	else if(pos == 4){
+		x0 -= tree_node_size(ctx,h);
+		y0 += tree_node_size(ctx,h);
+		leaf = insert_aux(ctx,m,x,y,root->NW,x0,y0,h+1,arena,id);
+	}
+	
+	// the body could not be placed, the nodes above it keep their mass
+	if(leaf == NULL) return NULL;
+		
+	// node's mass and mass center update
+	root->x += x*m/(root->mass);
+	root->x *= (root->mass)/(root->mass+m);
+	root->y += y*m/(root->mass);
+	root->y *= (root->mass)/(root->mass+m);
+	root->mass += m;
+	
+	return root;
+}
+
+
+double get_mass_aux(const tree_ctx_t *ctx, double x, double y,node_t *root, double x0, double y0, int h){
+
+	
+	if(root == NULL) return 0;
+	
+	// check if the node is indeed a lead (i.e. a body and not a mass center)
+	if(root -> NW == NULL && root -> NE == NULL && root -> SE == NULL && root -> SW == NULL){
+	
+		if(root->x == x && root->y == y) return root->mass;
+		
+		return 0;
+	}
+	
+	// binary-like search in the appropriate quadrant
+	int pos = get_quadrant(x,y,x0,y0);
+	
+	if(pos==1){
+	
+		// center of the next subquadrant
+		//
+		// universe_radius/pow(2,h) is the radius of a subquadrant 
+		// of a node at depth 'h' in the quadtree
+		x0 += tree_node_size(ctx,h);  
+		y0 += tree_node_size(ctx,h);
+		
+		// search in the next subquadrant
+		return get_mass_aux(ctx,x,y,root->NE,x0,y0,h+1);
+	}
+	
+	else if(pos==2){
+		x0 += tree_node_size(ctx,h);
+		y0 -= tree_node_size(ctx,h);
+		return get_mass_aux(ctx,x,y,root->SE,x0,y0,h+1);
+	}
+	
+	else if(pos==3){
+		x0 -= tree_node_size(ctx,h);
+		y0 -= tree_node_size(ctx,h);
+		return get_mass_aux(ctx,x,y,root->SW,x0,y0,h+1);
+	}
+	
+	else if(pos==4){
+		x0 -= tree_node_size(ctx,h);
+		y0 += tree_node_size(ctx,h);
+		return get_mass_aux(ctx,x,y,root->NW,x0,y0,h+1);
+	}
+	
+	return 0;		
+}
+
+
+size_t get_force_aux(const tree_ctx_t *ctx, double x, double y, double m, double *fx, double *fy, double theta, node_t* root, int h){
+	/*
+	calculates recursively the force following the barnes-hut approximation depending on the tollerance 'theta'
+	
+	returns the number of interactions, i.e. of nodes taken as a single point
+	*/
+	
+	
+	WALK_COUNT(visited, 1);
+	
+	// invalid node
+	if(root -> mass == 0 || (root -> x == x && root -> y == y)) return 0;
+	
+	double d = l2_norm(x,y,root->x,root->y);
+	double size = tree_node_size(ctx,h); // size of the current quadrant
+	int is_leaf = (root -> NW == NULL && root -> NE == NULL && root -> SE == NULL && root -> SW == NULL);
+	
+	
+	// the node's mass center is far enough from the  body
+	// to be considered a single point
+	// or we arrived to a leaf node
+	if(size/d < theta || is_leaf){
+		
+		if(is_leaf) WALK_COUNT(leaf, 1);
+			else WALK_COUNT(accepted, 1);
+		
+		double Dx = root->x - x;
+		double Dy = root->y - y;
+		double f = G*m*(root->mass)/pow(d,2); // modulus of the force
+		
+		// force components
+		*fx += f*Dx/d;
+		*fy += f*Dy/d;
+		
+		return 1;
+	}
+	
+	return get_force_aux(ctx, x, y, m, fx, fy, theta, root->NE, h+1)
+	     + get_force_aux(ctx, x, y, m, fx, fy, theta, root->SE, h+1)
+	     + get_force_aux(ctx, x, y, m, fx, fy, theta, root->SW, h+1)
+	     + get_force_aux(ctx, x, y, m, fx, fy, theta, root->NW, h+1);
+}
+
+
+double l2_norm(double x1, double y1, double x2, double y2){
+	/*
+	L2 distance between (x1,y1) and (x2,y2) vectors
+	*/
+	
+	return sqrt(pow(x1-x2, 2) + pow(y1-y2, 2));
+}
+
+
+node_t *build_parallel(const tree_ctx_t *ctx, const body_t *bodies, size_t n, node_arena_t *arena){
+	/*
+	builds the quad tree of the n bodies in the universe of 'ctx', the result
+	being the same of inserting them one after the other (bodies[i] having
+	index i), with the nodes taken from 'arena'
+	
+	returns the pointer to the tree
+	returns NULL if n = 0 or the allocation failed
+	*/
+	
+	if(n == 0) return NULL;
+	
+	int threads = 1;
+	
+#ifdef _OPENMP
+	// inside a parallel region the tree is built by the calling thread
+	threads = omp_in_parallel() ? 1 : omp_get_max_threads();
+#endif
+	
+	size_t *idx = malloc(sizeof(size_t)*n);
+	size_t *tmp = malloc(sizeof(size_t)*n);
+	node_arena_t *local = malloc(sizeof(node_arena_t)*threads);
+	
+	if(idx == NULL || tmp == NULL || local == NULL){
+		free(idx);
+		free(tmp);
+		free(local);
+		return NULL;
+	}
+	
+	for(size_t i=0; i<n; i++){
+		idx[i] = i;
+	}
+	
+	// every thread takes its nodes from its own arena, whose first block
+	// is a share of the one of 'arena', so the memory does not grow with
+	// the number of threads
+	size_t block_nodes = arena->block_nodes/threads;
+	
+	for(int t=0; t<threads; t++){
+		arena_init(&local[t], block_nodes);
+	}
+	
+	// the first thread goes on with the blocks of 'arena', the ones not
+	// handed out yet (e.g. after 'arena_reset') being dealt to the threads,
+	// so rebuilding a tree reuses its blocks instead of allocating new ones
+	node_block_t *spare = (arena->cur == NULL) ? NULL : arena->cur->next;
+	
+	if(arena->cur != NULL) arena->cur->next = NULL;
+	
+	local[0].head = arena->head;
+	local[0].cur = arena->cur;
+	arena->head = NULL;
+	arena->cur = NULL;
+	
+	for(int t=threads-1; spare != NULL; t=(t+threads-1)%threads){
+		node_block_t *b = spare;
+		spare = b->next;
+		arena_push(&local[t], b);
+	}
+	
+	int failed = 0;
+	node_t *root = new_node(0,0,0,&local[0]);
+	
+	if(root != NULL){
+		#pragma omp parallel num_threads(threads)
+		#pragma omp single
+		build_parallel_aux(ctx, bodies, idx, tmp, 0, n, root, ctx->cx, ctx->cy, 1, local, &failed);
+	}
+	
+	for(int t=0; t<threads; t++){
+		arena_merge(arena, &local[t]);
+	}
+	
+	free(idx);
+	free(tmp);
+	free(local);
+	
+	if(root == NULL || failed) return NULL;
+	
+	return root;
+}
+
+
+void build_parallel_aux(const tree_ctx_t *ctx, const body_t *bodies, size_t *idx, size_t *tmp, size_t a, size_t b, node_t *root, double x0, double y0, int h, node_arena_t *local, int *failed){
+	/*
+	builds the node 'root' of geometrical center (x0,y0) at depth 'h' (same
+	convention of 'insert_aux') holding the bodies idx[a],...,idx[b-1],
+	listed in increasing order of index
+	
+	big nodes are split in their 4 quadrants, each one built by its own
+	task, small nodes are built by inserting their bodies one by one
+	*/
+	
+	node_arena_t *arena = local;
+	
+#ifdef _OPENMP
+	arena = local + omp_get_thread_num();
+#endif
+	
+	// the first body of the node is where 'insert' starts from
+	const body_t *first = bodies + idx[a];
+	
+	root->x = first->x;
+	root->y = first->y;
+	root->mass = first->mass;
+	root->id = (long) idx[a];
+	
+	if(b - a == 1) return;
+	
+	if(b - a <= BUILD_TASK_BODIES){
+		for(size_t k=a+1; k<b; k++){
+			const body_t *p = bodies + idx[k];
+			if(insert_aux(ctx,p->mass,p->x,p->y,root,x0,y0,h,arena,(long) idx[k]) == NULL){
+				#pragma omp atomic write
+				*failed = 1;
+				return;
+			}
+		}
+		return;
+	}
+	
+	// node's mass and mass center update, replayed for every body
+	// in the same order and with the same operations of 'insert_aux'
+	// so the result is exactly the one of the serial insertion
+	for(size_t k=a+1; k<b; k++){
+		const body_t *p = bodies + idx[k];
+		root->x += p->x*p->mass/(root->mass);
+		root->x *= (root->mass)/(root->mass+p->mass);
+		root->y += p->y*p->mass/(root->mass);
+		root->y *= (root->mass)/(root->mass+p->mass);
+		root->mass += p->mass;
+	}
+	root->id = -1;
+	
+	// stable partition of the bodies in the 4 quadrants,
+	// each quadrant keeps its bodies in increasing order of index
+	size_t count[4] = {0, 0, 0, 0};
+	size_t start[4];
+	
+	for(size_t k=a; k<b; k++){
+		const body_t *p = bodies + idx[k];
+		count[get_quadrant(p->x,p->y,x0,y0)-1]++;
+	}
+	
+	start[0] = a;
+	for(int c=1; c<4; c++){
+		start[c] = start[c-1] + count[c-1];
+	}
+	
+	size_t next[4] = {start[0], start[1], start[2], start[3]};
+	
+	for(size_t k=a; k<b; k++){
+		const body_t *p = bodies + idx[k];
+		tmp[next[get_quadrant(p->x,p->y,x0,y0)-1]++] = idx[k];
+	}
+	memcpy(idx + a, tmp + a, sizeof(size_t)*(b - a));
+	
+	node_t *children[4];
+	new_children(children, arena);
+	
+	if(children[0] == NULL || children[1] == NULL || children[2] == NULL || children[3] == NULL){
+		#pragma omp atomic write
+		*failed = 1;
+		return;
+	}
+	
+	root->NE = children[0];
+	root->SE = children[1];
+	root->SW = children[2];
+	root->NW = children[3];
+	
+	// centers of the subquadrants, in the order of 'get_quadrant'
+	double r = tree_node_size(ctx,h);
+	double cx[4] = {x0 + r, x0 + r, x0 - r, x0 - r};
+	double cy[4] = {y0 + r, y0 - r, y0 - r, y0 + r};
+	
+	for(int c=0; c<4; c++){
+		
+		if(count[c] == 0) continue;
+		
+		#pragma omp task if(count[c] > BUILD_TASK_BODIES)
+		build_parallel_aux(ctx, bodies, idx, tmp, start[c], start[c] + count[c], children[c], cx[c], cy[c], h+1, local, failed);
+	}
+}
+
+
+const tree_ctx_t *universe_ctx(void){
+	/*
+	returns the context of the global universe of radius '_s' centered in (0,0)
+	
+	the context is refreshed only when '_s' changed, which happens
+	at the first insertion in a new universe and so never while
+	the tree is walked by several threads
+	*/
+	
+	if(universe.s != _s) tree_set_universe(&universe, _s, 0, 0);
+	
+	return &universe;
+}
+
+
+int inside_universe(const tree_ctx_t *ctx, double x, double y){
+	/*
+	returns 1 if (x,y) is inside the universe of the context, 0 otherwise
+	*/
+	
+	return (fabs(x - ctx->cx) < ctx->s && fabs(y - ctx->cy) < ctx->s);
+}
+
+
+void fit_universe(const body_t *bodies, size_t n, double *s, double *cx, double *cy){
+	/*
+	radius s and geometrical center (cx,cy) of the smallest square universe
+	holding the n bodies, enlarged a little so no body lies on its border
+	*/
+	
+	double xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+	
+	for(size_t i=0; i<n; i++){
+		if(i == 0 || bodies[i].x < xmin) xmin = bodies[i].x;
+		if(i == 0 || bodies[i].x > xmax) xmax = bodies[i].x;
+		if(i == 0 || bodies[i].y < ymin) ymin = bodies[i].y;
+		if(i == 0 || bodies[i].y > ymax) ymax = bodies[i].y;
+	}
+	
+	*cx = 0.5*(xmin + xmax);
+	*cy = 0.5*(ymin + ymax);
+	*s = 0.5*((xmax - xmin > ymax - ymin) ? xmax - xmin : ymax - ymin);
+	
+	// a single body, or all the bodies in the same point
+	if(*s == 0) *s = (fabs(*cx) + fabs(*cy) > 0) ? fabs(*cx) + fabs(*cy) : 1;
+	
+	*s *= 1.001;
+}
+
+
+void stats_aux(const node_t *root, int h, tree_stats_t *stats){
+	/*
+	adds to 'stats' the node 'root' at depth 'h' and its subtree
+	*/
+	
+	if(root == NULL) return;
+	
+	stats->nodes++;
+	stats->depth[(h < TREE_LEVELS) ? h : TREE_LEVELS-1]++;
+	if(h > stats->max_depth) stats->max_depth = h;
+	
+	if(root->NE == NULL && root->SE == NULL && root->SW == NULL && root->NW == NULL){
+		
+		if(root->mass == 0) stats->empty++;
+			else{
+				stats->leaves++;
+				stats->bodies++;
+			}
+		
+		return;
+	}
+	
+	stats_aux(root->NE, h+1, stats);
+	stats_aux(root->SE, h+1, stats);
+	stats_aux(root->SW, h+1, stats);
+	stats_aux(root->NW, h+1, stats);
+}
+
+
+size_t compact_count(const node_t *root){
+	/*
+	number of nodes of the subtree of 'root' holding bodies
+	*/
+	
+	if(root == NULL || root->mass == 0) return 0;
+	
+	return 1 + compact_count(root->NE) + compact_count(root->SE)
+	         + compact_count(root->SW) + compact_count(root->NW);
+}
+
+
+void compact_aux(const node_t *root, cnode_t *nodes, size_t k, size_t *next){
+	/*
+	copies the subtree of 'root' in nodes[k], whose occupied children
+	take the next free slots of the array, '*next' being the first one
+	
+	the children of a node are placed together, before the subtrees of
+	any of them, so the walk finds the 4 quadrants on the same cache lines
+	*/
+	
+	const node_t *children[4] = {root->NE, root->SE, root->SW, root->NW};
+	cnode_t *node = nodes + k;
+	
+	node -> x = root->x;
+	node -> y = root->y;
+	node -> mass = root->mass;
+	node -> id = root->id;
+	node -> mask = 0;
+	node -> first = (uint32_t) *next;
+	
+	for(int q=0; q<4; q++){
+		if(children[q] != NULL && children[q]->mass != 0) node->mask |= 1 << q;
+	}
+	
+	size_t first = *next;
+	*next += __builtin_popcount(node->mask);
+	
+	for(int q=0; q<4; q++){
+		if(node->mask & (1 << q)) compact_aux(children[q], nodes, first++, next);
+	}
+}
+
+
+double compact_node_size(const compact_tree_t *ct, int h){
+	/*
+	returns the radius of a node at depth h of the compact tree
+	*/
+	
+	if(h < TREE_LEVELS) return ct->size[h];
+	
+	return ldexp(ct->s, -h);
+}
+
+
+double compact_mass_aux(const compact_tree_t *ct, double x, double y, const cnode_t *node, double x0, double y0, int h){
+	/*
+	same as 'get_mass_aux' on the compact tree, an empty quadrant
+	being a missing bit of the mask
+	*/
+	
+	if(node->mask == 0){
+		
+		if(node->x == x && node->y == y) return node->mass;
+		
+		return 0;
+	}
+	
+	int pos = get_quadrant(x,y,x0,y0);
+	int bit = 1 << (pos-1);
+	
+	if(!(node->mask & bit)) return 0;
+	
+	// center of the next subquadrant
+	double size = compact_node_size(ct,h);
+	
+	x0 += (pos == 1 || pos == 2) ? size : -size;
+	y0 += (pos == 1 || pos == 4) ? size : -size;
+	
+	// the occupied quadrants before 'pos' come first in the array
+	const cnode_t *child = ct->nodes + node->first + __builtin_popcount(node->mask & (bit-1));
+	
+	return compact_mass_aux(ct,x,y,child,x0,y0,h+1);
+}
+
+
+void compact_force_aux(const compact_tree_t *ct, double x, double y, double m, double *fx, double *fy, double theta, const cnode_t *node, int h){
+	/*
+	same as 'get_force_aux' on the compact tree, every node visited
+	holding bodies
+	*/
+	
+	WALK_COUNT(visited, 1);
+	
+	if(node -> x == x && node -> y == y) return;
+	
+	double d = l2_norm(x,y,node->x,node->y);
+	double size = compact_node_size(ct,h);
+	
+	if(size/d < theta || node->mask == 0){
+		
+		if(node->mask == 0) WALK_COUNT(leaf, 1);
+			else WALK_COUNT(accepted, 1);
+		
+		double Dx = node->x - x;
+		double Dy = node->y - y;
+		double f = G*m*(node->mass)/pow(d,2);
+		
+		*fx += f*Dx/d;
+		*fy += f*Dy/d;
+		
+		return;
+	}
+	
+	const cnode_t *child = ct->nodes + node->first;
+	int nchild = __builtin_popcount(node->mask);
+	
+	for(int c=0; c<nchild; c++){
+		compact_force_aux(ct, x, y, m, fx, fy, theta, child + c, h+1);
+	}
+}
+
+
+void compact_stats_aux(const compact_tree_t *ct, const cnode_t *node, int h, tree_stats_t *stats){
+	/*
+	adds to 'stats' the node at depth 'h' and its subtree
+	*/
+	
+	stats->nodes++;
+	stats->depth[(h < TREE_LEVELS) ? h : TREE_LEVELS-1]++;
+	if(h > stats->max_depth) stats->max_depth = h;
+	
+	if(node->mask == 0){
+		stats->leaves++;
+		stats->bodies++;
+		return;
+	}
+	
+	const cnode_t *child = ct->nodes + node->first;
+	int nchild = __builtin_popcount(node->mask);
+	
+	for(int c=0; c<nchild; c++){
+		compact_stats_aux(ct, child + c, h+1, stats);
+	}
+}
+
+
+void mixed_aux(const compact_tree_t *ct, size_t k, double x0, double y0, int h){
+	/*
+	copies in single precision the node k, at depth h and with geometrical
+	center (x0,y0), and its subtree, the offsets in units of the radius
+	of the universe
+	*/
+	
+	const cnode_t *node = ct->nodes + k;
+	cnodef_t *fnode = ct->fnodes + k;
+	
+	fnode -> dx = (float) ((node->x - x0)/ct->s);
+	fnode -> dy = (float) ((node->y - y0)/ct->s);
+	fnode -> mass = (float) (node->mass/ct->nodes[0].mass);
+	fnode -> first = node->first;
+	fnode -> mask = node->mask;
+	
+	double c = compact_node_size(ct,h+1);
+	size_t child = node->first;
+	
+	// quadrants NE, SE, SW, NW
+	for(int q=0; q<4; q++){
+		if(node->mask & (1 << q)) mixed_aux(ct, child++, x0 + ((q < 2) ? c : -c), y0 + ((q == 0 || q == 3) ? c : -c), h+1);
+	}
+}
+
+
+void mixed_force_aux(const compact_tree_t *ct, double x, double y, const float *open, size_t k, double x0, double y0, int h, mixed_batch_t *batch){
+	/*
+	same as 'compact_force_aux' in mixed precision for the node k, at depth
+	h and with geometrical center (x0,y0), adding the nodes taken as a single
+	point and the bodies to the batch
+	
+	the nodes to open are kept in a stack instead of a recursion, only the
+	subtrees deeper than the stack allows being walked by a recursive call
+	*/
+	
+	struct {
+		size_t k;
+		double x0, y0;
+		int h;
+	} stack[3*TREE_LEVELS+1];
+	
+	int top = 0;
+	double inv_s = 1/ct->s;
+	
+	stack[top].k = k;
+	stack[top].x0 = x0;
+	stack[top].y0 = y0;
+	stack[top].h = h;
+	top++;
+	
+	while(top > 0){
+		
+		top--;
+		k = stack[top].k;
+		x0 = stack[top].x0;
+		y0 = stack[top].y0;
+		h = stack[top].h;
+		
+		const cnodef_t *node = ct->fnodes + k;
+		
+		WALK_COUNT(visited, 1);
+		
+		// a body, summed in double precision
+		if(node->mask == 0){
+			
+			const cnode_t *leaf = ct->nodes + k;
+			
+			if(leaf->x == x && leaf->y == y) continue;
+			
+			WALK_COUNT(leaf, 1);
+			
+			if(batch->n_near == MIXED_BATCH) mixed_flush(x,y,batch);
+			
+			batch->x[batch->n_near] = leaf->x;
+			batch->y[batch->n_near] = leaf->y;
+			batch->m[batch->n_near] = leaf->mass;
+			batch->n_near++;
+			
+			continue;
+		}
+		
+		// the mass center from the body in units of the radius of the universe,
+		// so the single precision stays far from overflow and underflow at any
+		// scale: the distance of the geometrical center, which may be large, is
+		// taken in double precision and the offset of the mass center, at most
+		// the size of the node, in single precision
+		float dx = (float) ((x0 - x)*inv_s) + node->dx;
+		float dy = (float) ((y0 - y)*inv_s) + node->dy;
+		float d2 = dx*dx + dy*dy;
+		
+		// size/d < theta without the square root, the nodes deeper
+		// than the table being always opened down to the bodies
+		if(h < TREE_LEVELS && d2 > open[h]){
+			
+			WALK_COUNT(accepted, 1);
+			
+			if(batch->n_far == MIXED_BATCH) mixed_flush(x,y,batch);
+			
+			batch->dx[batch->n_far] = dx;
+			batch->dy[batch->n_far] = dy;
+			batch->fm[batch->n_far] = node->mass;
+			batch->n_far++;
+			
+			continue;
+		}
+		
+		// the children are pushed from the last one,
+		// so they are walked in the order NE, SE, SW, NW
+		double c = compact_node_size(ct,h+1);
+		size_t child = node->first + __builtin_popcount(node->mask);
+		
+		for(int q=3; q>=0; q--){
+			
+			if(!(node->mask & (1 << q))) continue;
+			
+			double cx = x0 + ((q < 2) ? c : -c);
+			double cy = y0 + ((q == 0 || q == 3) ? c : -c);
+			
+			child--;
+			
+			if(top == 3*TREE_LEVELS+1){
+				mixed_force_aux(ct, x, y, open, child, cx, cy, h+1, batch);
+				continue;
+			}
+			
+			stack[top].k = child;
+			stack[top].x0 = cx;
+			stack[top].y0 = cy;
+			stack[top].h = h+1;
+			top++;
+		}
+	}
+}
+
+
+void mixed_flush(double x, double y, mixed_batch_t *batch){
+	/*
+	sums the interactions of the batch with the body in (x,y)
+	by the vectorized kernels and empties it
+	*/
+	
+	pp_kernel_float(batch->dx, batch->dy, batch->fm, batch->n_far, &batch->far[0], &batch->far[1]);
+	pp_kernel(x, y, batch->x, batch->y, batch->m, batch->n_near, &batch->near[0], &batch->near[1]);
+	
+	batch->n_far = 0;
+	batch->n_near = 0;
 }
@@ -1,10 +1,20 @@
 #ifndef __BARNES_STATIC__H
 #define __BARNES_STATIC__H
 #include <stdio.h>
+#include <stdint.h>
 
 
+#define G 0.0000000000667 // gravitational coupling constant
+
 // global variable defining the radius of the universe
-double _s;
+// (defined in barnes_static.c)
+extern double _s;
+
+// body of the N-body problem
+typedef struct body {
+  double x, y;
+  double mass;
+} body_t;
 
 // quadtree structure
 typedef struct node {
@@ -16,11 +26,160 @@ typedef struct node {
   // total mass if central node or body mass if leaf node
   double mass; 
   
+  // index of the body in a leaf inserted with 'insert_indexed',
+  // -1 otherwise
+  long id;
+  
   // pointer to quadrants
   struct node * NW, *NE, *SE, *SW;
 } node_t;
 
 
+// block of contiguous nodes owned by an arena
+typedef struct node_block {
+  struct node_block *next;
+  size_t cap;   // number of nodes in the block
+  size_t used;  // nodes already handed out
+  node_t nodes[];
+} node_block_t;
+
+// pool allocator for the quadtree nodes
+//
+// nodes are handed out from big contiguous blocks, so the four
+// children of a split are adjacent in memory and the whole tree
+// is released at once instead of node by node
+typedef struct node_arena {
+  node_block_t *head; // first block of the chain
+  node_block_t *cur;  // block currently handing out nodes
+  size_t block_nodes; // size of the first block
+} node_arena_t;
+
+// depths whose node radius is kept in the table of a tree context
+#define TREE_LEVELS 64
+
+// quadtree together with the universe it is built in
+//
+// every tree context carries its own extent and nodes, so trees of
+// different universes can be built and walked at the same time,
+// each one by its own thread
+typedef struct tree_ctx {
+
+  // radius and geometrical center of the universe
+  double s;
+  double cx, cy;
+
+  // radius of a node for every depth, size[h] = s/2^h
+  double size[TREE_LEVELS];
+
+  // nodes of the tree and its root
+  node_arena_t arena;
+  node_t *root;
+
+  // one more than the largest id in the tree, the
+  // first id given by 'tree_build' to a new body
+  long next_id;
+} tree_ctx_t;
+
+// node of the compact quadtree (see 'tree_compact')
+//
+// only the occupied quadrants of a node are stored, one after the other
+// from 'first' in the order NE, SE, SW, NW: bit q-1 of 'mask' is set if
+// the quadrant q (see 'get_quadrant') holds bodies, mask = 0 for a leaf
+typedef struct cnode {
+  double x, y;
+  double mass;
+  long id;
+  uint32_t first;
+  uint8_t mask;
+} cnode_t;
+
+// node of the compact quadtree in single precision (see 'compact_mixed')
+//
+// the mass center is kept relative to the geometrical center of the
+// node, so its error follows the size of the node instead of the one of
+// the universe, in units of the radius of the universe, so the single
+// precision holds at any scale, and the mass as a fraction of the total mass
+typedef struct cnodef {
+  float dx, dy;
+  float mass;
+  uint32_t first;
+  uint8_t mask;
+} cnodef_t;
+
+// read-only copy of a tree with no empty quadrants, whose nodes are
+// stored in a single array with the children of a node contiguous
+typedef struct compact_tree {
+
+  // radius and geometrical center of the universe,
+  // and radius of a node for every depth
+  double s;
+  double cx, cy;
+  double size[TREE_LEVELS];
+
+  // nodes, the root is nodes[0]
+  cnode_t *nodes;
+  size_t n_nodes;
+
+  // single precision copy of the nodes,
+  // NULL unless made by 'compact_mixed'
+  cnodef_t *fnodes;
+} compact_tree_t;
+
+// independent N-body problem of a batch (see 'forces_batch')
+typedef struct problem {
+
+  const body_t *bodies;
+  size_t n;
+
+  // radius and geometrical center of the universe,
+  // s <= 0 to fit the universe to the bodies
+  double s;
+  double cx, cy;
+
+  // tollerance of the force
+  double theta;
+
+  // force on every body (output)
+  double *fx, *fy;
+} problem_t;
+
+// shape and memory of a tree (see 'tree_stats')
+typedef struct tree_stats {
+  size_t nodes;   // all the nodes
+  size_t leaves;  // leaves holding bodies
+  size_t empty;   // empty nodes, i.e. placeholders with no body
+  size_t bodies;  // bodies in the leaves
+  size_t bytes;   // memory of the nodes
+  int max_depth;
+
+  // nodes at every depth, the ones deeper than TREE_LEVELS-1 in the last
+  size_t depth[TREE_LEVELS];
+} tree_stats_t;
+
+// counters of the force walks (see 'walk_stats_read')
+typedef struct walk_stats {
+  size_t walks;    // forces calculated
+  size_t visited;  // nodes visited
+  size_t accepted; // nodes approximated as a single point
+  size_t leaf;     // interactions with single bodies
+} walk_stats_t;
+
+// the walks update the counters only when compiled with -DBH_STATS,
+// otherwise the counting compiles to nothing (the count is evaluated
+// and discarded, so the variables it uses are never left unused)
+//
+// a walk counts in a counter of its thread, which is added
+// to the global one when the walk is over
+#ifdef BH_STATS
+extern _Thread_local walk_stats_t walk_counters;
+#define WALK_COUNT(field, k) (walk_counters.field += (k))
+#define WALK_FLUSH() walk_stats_flush()
+#else
+#define WALK_COUNT(field, k) ((void) (k))
+#define WALK_FLUSH() ((void) 0)
+#endif
+
+
 	/*
 	extracts the value of the x,y coordinates and mass m for a body
 	from a string formatted as "x y m" i.e. the values separated by 
@@ -29,7 +188,7 @@ typedef struct node {
 	returns 0 if the conversion happened succesfully
 	returns -1 otherwise and do not change the variables x, y, m
 	*/
-int body_to_string (const char* s, double* x, double* y, double* m);
+int string_to_body (const char* s, double* x, double* y, double* m);
 
 
 	/*
@@ -37,6 +196,8 @@ int body_to_string (const char* s, double* x, double* y, double* m);
 	with root pointed by 'root'
 	
 	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
 	*/
 node_t* insert (double m, double x, double y, node_t * root);
 
@@ -47,12 +208,81 @@ node_t* insert (double m, double x, double y, node_t * root);
 void print_tree (FILE * f, int mode, node_t * root);
 
 
+  /*
+  prints the statistics of a tree in a file (e.g. stdout), one line
+  with the counts followed by the histogram of the depths
+  */
+void print_stats (FILE * f, const tree_stats_t * stats);
+
+
 	/*
 	deallocates the whole quad tree
+
+	not to be used on trees built with 'insert_arena',
+	for those use 'arena_reset' or 'arena_free'
 	*/
 void free_tree (node_t * root);
 
 
+	/*
+	initializes an empty arena, the first block holds 'block_nodes'
+	nodes and every new block doubles the size of the previous one
+	*/
+void arena_init (node_arena_t * arena, size_t block_nodes);
+
+
+	/*
+	makes all the nodes of the arena available again in O(1),
+	the blocks are kept for the next tree
+	*/
+void arena_reset (node_arena_t * arena);
+
+
+	/*
+	releases all the blocks of the arena, and so every tree built in it
+	*/
+void arena_free (node_arena_t * arena);
+
+
+	/*
+	same as 'insert' but the nodes are taken from 'arena'
+	
+	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
+	*/
+node_t* insert_arena (double m, double x, double y, node_t * root, node_arena_t * arena);
+
+
+	/*
+	same as 'insert_arena' but the leaf of the body keeps
+	the index 'id' of the body
+	
+	returns the pointer to the updated tree
+	returns NULL if the allocation failed, the tree keeping
+	the bodies it had and the body being not inserted
+	*/
+node_t* insert_indexed (long id, double m, double x, double y, node_t * root, node_arena_t * arena);
+
+
+	/*
+	builds the quad tree of the n bodies in parallel (if compiled with
+	OpenMP), the result being exactly the same of inserting them one after
+	the other with 'insert_indexed' (bodies[i] having index i)
+	
+	the upper levels are split in independent quadrants built by their own
+	task, the mass centers of the upper nodes are then obtained replaying
+	the updates of the serial insertion; the nodes are taken from 'arena',
+	every thread having its own blocks (the ones 'arena' has not handed
+	out yet, e.g. after 'arena_reset', or new ones of a share of its first
+	block), which all belong to 'arena' afterwards
+	
+	returns the pointer to the tree
+	returns NULL if n = 0 or the allocation failed
+	*/
+node_t* insert_parallel (const body_t * bodies, size_t n, node_arena_t * arena);
+
+
 	/*
 	returns mass of the body in (x,y)
 	
@@ -67,5 +297,202 @@ double get_mass (double x, double y, node_t* root);
 	given a tollerance 'theta'
 	*/
 void get_force (double x, double y, double *fx, double* fy, double theta, node_t* root);
+
+
+	/*
+	same as 'get_force' for a body of known mass m, skipping the lookup
+	*/
+void get_force_body (double x, double y, double m, double *fx, double* fy, double theta, node_t* root);
+
+
+	/*
+	the functions above read the radius '_s' of a single, global
+	universe centered in (0,0) and are not reentrant; the ones below
+	work on a tree context instead, and different contexts can be used
+	at the same time by different threads
+	*/
+
+
+	/*
+	initializes an empty tree in the universe of radius s and
+	geometrical center (cx,cy), with the nodes taken from an
+	arena whose first block holds 'block_nodes' nodes
+	*/
+void tree_init (tree_ctx_t * ctx, double s, double cx, double cy, size_t block_nodes);
+
+
+	/*
+	moves the tree to the universe of radius s and geometrical center
+	(cx,cy), to be called on an empty tree (e.g. after 'tree_reset')
+	*/
+void tree_set_universe (tree_ctx_t * ctx, double s, double cx, double cy);
+
+
+	/*
+	empties the tree in O(1), the nodes are kept for the next one
+	*/
+void tree_reset (tree_ctx_t * ctx);
+
+
+	/*
+	deallocates the nodes of the tree
+	*/
+void tree_free (tree_ctx_t * ctx);
+
+
+	/*
+	returns the radius of a node at depth h of the tree
+	(the universe being at depth 0)
+	*/
+double tree_node_size (const tree_ctx_t * ctx, int h);
+
+
+	/*
+	same as 'insert_indexed' for the tree of the context
+	
+	returns 0 if the body was inserted succesfully
+	returns -1 if the body is outside the universe or the allocation failed
+	*/
+int tree_insert (tree_ctx_t * ctx, long id, double m, double x, double y);
+
+
+	/*
+	same as 'insert_parallel' for the tree of the context, the n bodies
+	are added to the ones already in it; when called from a parallel
+	region the tree is built by the calling thread alone
+	
+	bodies[i] has id i in an empty tree, and id next_id + i otherwise,
+	so the ids never collide with the ones already in the tree (e.g. as
+	returned by 'tree_range' and 'tree_knn')
+	
+	returns 0 if the bodies were inserted succesfully
+	returns -1 if a body is outside the universe or the allocation failed
+	*/
+int tree_build (tree_ctx_t * ctx, const body_t * bodies, size_t n);
+
+
+	/*
+	same as 'get_mass' for the tree of the context
+	*/
+double tree_get_mass (const tree_ctx_t * ctx, double x, double y);
+
+
+	/*
+	same as 'get_force_body' for the tree of the context
+	
+	returns the number of interactions of the walk (nodes taken
+	as a single point), a measure of the cost of the force
+	*/
+size_t tree_get_force (const tree_ctx_t * ctx, double x, double y, double m, double *fx, double* fy, double theta);
+
+
+	/*
+	calculates the forces of 'count' independent problems: the problems
+	are spread over the threads (if compiled with OpenMP), every thread
+	building and walking the trees of its problems in a context of its
+	own, whose nodes are reused from one problem to the next
+	
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+int forces_batch (problem_t * problems, size_t count);
+
+
+	/*
+	copies the tree of the context in 'ct' leaving out the empty
+	quadrants, the children of every node being contiguous; the
+	context can then be freed or reused for another tree
+	
+	the walks of the compact tree visit the nodes in the same order
+	of the ones of the context, so the forces are exactly the same
+	
+	returns 0 if the tree was copied succesfully
+	returns -1 otherwise
+	*/
+int tree_compact (const tree_ctx_t * ctx, compact_tree_t * ct);
+
+
+	/*
+	deallocates the nodes of the compact tree
+	*/
+void compact_free (compact_tree_t * ct);
+
+
+	/*
+	same as 'tree_get_mass' for the compact tree
+	*/
+double compact_get_mass (const compact_tree_t * ct, double x, double y);
+
+
+	/*
+	same as 'tree_get_force' for the compact tree
+	*/
+void compact_get_force (const compact_tree_t * ct, double x, double y, double m, double *fx, double* fy, double theta);
+
+
+	/*
+	makes the single precision copy of the nodes used by
+	'compact_get_force_mixed'
+	
+	returns 0 if the copy was made succesfully
+	returns -1 otherwise
+	*/
+int compact_mixed (compact_tree_t * ct);
+
+
+	/*
+	same as 'compact_get_force' in mixed precision: the walk reads only
+	the single precision copy of the nodes (half the memory) and the nodes
+	taken as a single point are summed in single precision, with an
+	approximated reciprocal square root, into double precision sums, while
+	the single bodies of the leaves are summed in double precision as they
+	are; the difference from 'compact_get_force' is much smaller than the
+	error of the approximation given by 'theta'
+	
+	without the copy of 'compact_mixed' it is the same as 'compact_get_force'
+	*/
+void compact_get_force_mixed (const compact_tree_t * ct, double x, double y, double m, double *fx, double* fy, double theta);
+
+
+	/*
+	same as 'tree_stats' for the compact tree, the memory
+	including the single precision copy if made by 'compact_mixed'
+	*/
+void compact_stats (const compact_tree_t * ct, tree_stats_t * stats);
+
+
+	/*
+	shape and memory of the tree pointed by 'root': nodes by kind and
+	by depth, the memory being the one of the nodes in use (see
+	'arena_bytes' for the memory reserved by an arena)
+	*/
+void tree_stats (const node_t * root, tree_stats_t * stats);
+
+
+	/*
+	returns the memory reserved by the blocks of the arena in bytes
+	*/
+size_t arena_bytes (const node_arena_t * arena);
+
+
+	/*
+	sets to 0 the counters of the force walks
+	*/
+void walk_stats_reset (void);
+
+
+	/*
+	reads the counters of the force walks done since the last
+	'walk_stats_reset', by all the threads; they are always 0
+	unless the code is compiled with -DBH_STATS
+	*/
+void walk_stats_read (walk_stats_t * stats);
+
+
+	/*
+	adds the counts of the calling thread to the global counters,
+	called by the walks when they are over
+	*/
+void walk_stats_flush (void);
 #endif
 
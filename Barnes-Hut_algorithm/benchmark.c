@@ -0,0 +1,552 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "barnes_static.h"
+#include "linear_tree.h"
+
+#define MAX_LIST 16 // longest list of sizes or tollerances
+#define MAX_SAMPLE 1000 // bodies whose force is checked against the direct sum
+#define GROUP_SIZE 32 // bodies of a group of 'get_forces_group'
+#define UNIVERSE 1000.0 // default radius of the universe
+
+// the nodes visited are the ones counted by the walks themselves
+#ifndef BH_STATS
+#error "the benchmark reads the counters of the walks, compile it with -DBH_STATS"
+#endif
+
+// the distributions of bodies
+enum {UNIFORM, PLUMMER, CLUSTERED, N_DISTRIBUTIONS};
+const char *distribution_names[N_DISTRIBUTIONS] = {"uniform", "plummer", "clustered"};
+
+// the tree codes measured
+enum {POINTER, COMPACT, MIXED, LINEAR, QUADRUPOLE, GROUP, N_METHODS};
+const char *method_names[N_METHODS] = {"pointer", "compact", "mixed", "linear", "quadrupole", "group"};
+
+// result of a run
+typedef struct result {
+  double build;   // time to build the tree (s)
+  double convert; // time to turn it into the tree walked, e.g. compact (s)
+  double force;   // time to calculate all the forces (s)
+  double visits;  // nodes visited per body (see 'walk_stats_read')
+  size_t tree_kb; // memory of the tree walked (kB)
+  double rms, max; // relative error of the force on the sample
+} result_t;
+
+
+uint64_t next_random(uint64_t *state);
+double uniform(uint64_t *state);
+void generate(body_t *bodies, size_t n, int distribution, uint64_t seed);
+double now(void);
+void direct_force(const body_t *bodies, size_t n, size_t i, double *fx, double *fy);
+void check_forces(const body_t *bodies, size_t n, const double *fx, const double *fy, const size_t *sample, size_t n_sample, result_t *r);
+int run(const body_t *bodies, size_t n, double theta, int method, const size_t *sample, size_t n_sample, result_t *r);
+int parse_list(const char *s, double *values, int max);
+int find_name(const char *s, const char **names, int count);
+void usage(const char *name);
+
+
+int main(int argc, char **argv){
+	/*
+	measures build time, force time, nodes visited, memory and accuracy
+	of the tree codes for every distribution, size and tollerance asked,
+	one line (CSV) or object (JSON) for every run
+
+	e.g. ./benchmark -d plummer -n 1000,100000 -t 0.3,0.5,0.8 -f json
+	*/
+
+	double sizes[MAX_LIST] = {1e3, 1e4, 1e5, 1e6};
+	double thetas[MAX_LIST] = {0.5};
+	int n_sizes = 4, n_thetas = 1;
+	int distributions[N_DISTRIBUTIONS] = {1, 1, 1};
+	int methods[N_METHODS] = {1, 1, 1, 1, 1, 1};
+	int json = 0;
+	uint64_t seed = 1;
+	double radius = UNIVERSE;
+
+	for(int a=1; a<argc; a++){
+
+		const char *value = (a+1 < argc) ? argv[a+1] : NULL;
+
+		if(value == NULL){
+			usage(argv[0]);
+			return 1;
+		}
+
+		if(strcmp(argv[a], "-n") == 0) n_sizes = parse_list(value, sizes, MAX_LIST);
+		else if(strcmp(argv[a], "-t") == 0) n_thetas = parse_list(value, thetas, MAX_LIST);
+		else if(strcmp(argv[a], "-s") == 0) seed = strtoull(value, NULL, 10);
+		else if(strcmp(argv[a], "-r") == 0) radius = strtod(value, NULL);
+		else if(strcmp(argv[a], "-f") == 0){
+			if(strcmp(value, "csv") != 0 && strcmp(value, "json") != 0){
+				usage(argv[0]);
+				return 1;
+			}
+			json = (strcmp(value, "json") == 0);
+		}
+		else if(strcmp(argv[a], "-d") == 0){
+			int d = find_name(value, distribution_names, N_DISTRIBUTIONS);
+			if(d < 0){
+				usage(argv[0]);
+				return 1;
+			}
+			memset(distributions, 0, sizeof(distributions));
+			distributions[d] = 1;
+		}
+		else if(strcmp(argv[a], "-m") == 0){
+			int m = find_name(value, method_names, N_METHODS);
+			if(m < 0){
+				usage(argv[0]);
+				return 1;
+			}
+			memset(methods, 0, sizeof(methods));
+			methods[m] = 1;
+		}
+		else{
+			usage(argv[0]);
+			return 1;
+		}
+
+		a++;
+	}
+
+	if(n_sizes <= 0 || n_thetas <= 0 || !(radius > 0)){
+		usage(argv[0]);
+		return 1;
+	}
+
+	// the bodies are generated and the trees built in this universe
+	_s = radius;
+
+	if(json) printf("[\n");
+		else printf("distribution,n,radius,theta,method,build_s,convert_s,force_s,force_ns_per_body,visits_per_body,tree_kb,rms_error,max_error\n");
+
+	int first = 1;
+
+	for(int d=0; d<N_DISTRIBUTIONS; d++){
+
+		if(!distributions[d]) continue;
+
+		for(int k=0; k<n_sizes; k++){
+
+			size_t n = (size_t) sizes[k];
+			body_t *bodies = malloc(sizeof(body_t)*n);
+
+			if(bodies == NULL){
+				fprintf(stderr, "not enough memory for %zu bodies\n", n);
+				return 1;
+			}
+
+			generate(bodies, n, d, seed);
+
+			// the same bodies are checked by every method, evenly spread
+			// over the generated ones
+			size_t n_sample = (n < MAX_SAMPLE) ? n : MAX_SAMPLE;
+			size_t sample[MAX_SAMPLE];
+
+			for(size_t j=0; j<n_sample; j++){
+				sample[j] = j*(n/n_sample);
+			}
+
+			for(int t=0; t<n_thetas; t++){
+				for(int m=0; m<N_METHODS; m++){
+
+					if(!methods[m]) continue;
+
+					result_t r;
+
+					if(run(bodies, n, thetas[t], m, sample, n_sample, &r) != 0){
+						fprintf(stderr, "%s failed on %zu bodies\n", method_names[m], n);
+						continue;
+					}
+
+					if(json){
+						printf("%s  {\"distribution\": \"%s\", \"n\": %zu, \"radius\": %g, \"theta\": %g, \"method\": \"%s\", "
+						       "\"build_s\": %.6e, \"convert_s\": %.6e, \"force_s\": %.6e, \"force_ns_per_body\": %.3f, "
+						       "\"visits_per_body\": %.2f, \"tree_kb\": %zu, \"rms_error\": %.6e, \"max_error\": %.6e}",
+						       first ? "" : ",\n", distribution_names[d], n, radius, thetas[t], method_names[m],
+						       r.build, r.convert, r.force, 1e9*r.force/n, r.visits, r.tree_kb, r.rms, r.max);
+					}
+
+					else{
+						printf("%s,%zu,%g,%g,%s,%.6e,%.6e,%.6e,%.3f,%.2f,%zu,%.6e,%.6e\n",
+						       distribution_names[d], n, radius, thetas[t], method_names[m],
+						       r.build, r.convert, r.force, 1e9*r.force/n, r.visits, r.tree_kb, r.rms, r.max);
+					}
+
+					first = 0;
+					fflush(stdout);
+				}
+			}
+
+			free(bodies);
+		}
+	}
+
+	if(json) printf("\n]\n");
+
+	return 0;
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+uint64_t next_random(uint64_t *state){
+	/*
+	splitmix64 generator, the same sequence on every platform
+	for the same seed
+	*/
+
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+
+double uniform(uint64_t *state){
+	/*
+	uniform random number in [0,1)
+	*/
+
+	return (next_random(state) >> 11)*0x1.0p-53;
+}
+
+
+void generate(body_t *bodies, size_t n, int distribution, uint64_t seed){
+	/*
+	n bodies of the given distribution inside the universe, the masses
+	uniform in [1,100); the same seed gives the same bodies
+
+	- uniform: uniform in the square of radius 0.95*_s
+	- plummer: projection on the plane of a Plummer sphere of scale
+	  radius _s/20, truncated at 0.95*_s
+	- clustered: 32 gaussian clusters of random width and weight
+	  over a uniform background holding a tenth of the bodies
+	*/
+
+	uint64_t state = seed;
+	double r_max = 0.95*_s;
+	double cx[32], cy[32], width[32], weight[32];
+	double total = 0;
+
+	if(distribution == CLUSTERED){
+		for(int c=0; c<32; c++){
+			cx[c] = (2*uniform(&state) - 1)*0.8*_s;
+			cy[c] = (2*uniform(&state) - 1)*0.8*_s;
+			width[c] = _s*(0.002 + 0.02*uniform(&state));
+			weight[c] = uniform(&state);
+			total += weight[c];
+		}
+	}
+
+	for(size_t i=0; i<n; i++){
+
+		double x = 0, y = 0;
+
+		if(distribution == UNIFORM){
+			x = (2*uniform(&state) - 1)*r_max;
+			y = (2*uniform(&state) - 1)*r_max;
+		}
+
+		else if(distribution == PLUMMER){
+
+			// radius from the inverse of the cumulative mass, direction
+			// uniform on the sphere, the z coordinate being dropped
+			double r;
+
+			do{
+				double u = uniform(&state);
+				r = _s/20/sqrt(pow(u, -2.0/3) - 1);
+			} while(!(r < r_max));
+
+			double cos_t = 2*uniform(&state) - 1;
+			double phi = 2*M_PI*uniform(&state);
+			double rho = r*sqrt(1 - cos_t*cos_t);
+
+			x = rho*cos(phi);
+			y = rho*sin(phi);
+		}
+
+		else{
+
+			do{
+				if(uniform(&state) < 0.1){
+					x = (2*uniform(&state) - 1)*r_max;
+					y = (2*uniform(&state) - 1)*r_max;
+					continue;
+				}
+
+				// cluster chosen by weight, gaussian by Box-Muller
+				double u = uniform(&state)*total;
+				int c = 0;
+
+				while(c < 31 && u >= weight[c]){
+					u -= weight[c];
+					c++;
+				}
+
+				double rad = sqrt(-2*log(1 - uniform(&state)));
+				double phi = 2*M_PI*uniform(&state);
+
+				x = cx[c] + width[c]*rad*cos(phi);
+				y = cy[c] + width[c]*rad*sin(phi);
+
+			} while(fabs(x) >= r_max || fabs(y) >= r_max);
+		}
+
+		bodies[i].x = x;
+		bodies[i].y = y;
+		bodies[i].mass = 1 + 99*uniform(&state);
+	}
+}
+
+
+double now(void){
+	/*
+	wall clock time in seconds
+	*/
+
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+
+void direct_force(const body_t *bodies, size_t n, size_t i, double *fx, double *fy){
+	/*
+	exact force on the i-th body, by direct summation over the others
+	*/
+
+	double ax = 0, ay = 0;
+
+	for(size_t j=0; j<n; j++){
+
+		double dx = bodies[j].x - bodies[i].x;
+		double dy = bodies[j].y - bodies[i].y;
+		double d2 = dx*dx + dy*dy;
+
+		if(j == i || d2 == 0) continue;
+
+		double w = bodies[j].mass/(d2*sqrt(d2));
+
+		ax += w*dx;
+		ay += w*dy;
+	}
+
+	*fx = G*bodies[i].mass*ax;
+	*fy = G*bodies[i].mass*ay;
+}
+
+
+void check_forces(const body_t *bodies, size_t n, const double *fx, const double *fy, const size_t *sample, size_t n_sample, result_t *r){
+	/*
+	RMS and maximum relative error of the forces of the sample bodies
+	with respect to the direct summation
+	*/
+
+	double sum = 0, max = 0;
+
+	#pragma omp parallel for schedule(dynamic, 4) reduction(+:sum) reduction(max:max)
+	for(size_t j=0; j<n_sample; j++){
+
+		size_t i = sample[j];
+		double ex, ey;
+
+		direct_force(bodies, n, i, &ex, &ey);
+
+		double norm = sqrt(ex*ex + ey*ey);
+
+		if(norm == 0) continue;
+
+		double err = sqrt(pow(fx[i] - ex, 2) + pow(fy[i] - ey, 2))/norm;
+
+		sum += err*err;
+		if(err > max) max = err;
+	}
+
+	r->rms = sqrt(sum/n_sample);
+	r->max = max;
+}
+
+
+int run(const body_t *bodies, size_t n, double theta, int method, const size_t *sample, size_t n_sample, result_t *r){
+	/*
+	builds the tree of the n bodies with the given method, calculates
+	all the forces and measures the run
+
+	returns 0 if the run happened succesfully
+	returns -1 otherwise
+	*/
+
+	double *fx = malloc(sizeof(double)*n);
+	double *fy = malloc(sizeof(double)*n);
+
+	if(fx == NULL || fy == NULL){
+		free(fx);
+		free(fy);
+		return -1;
+	}
+
+	memset(r, 0, sizeof(result_t));
+
+	int failed = 0;
+	double t0 = now();
+
+	// every pointer method is built by the same parallel 'tree_build', the
+	// copies walked by the compact and mixed ones being timed on their own
+	if(method == POINTER || method == COMPACT || method == MIXED){
+
+		tree_ctx_t ctx;
+		compact_tree_t ct;
+		tree_stats_t stats;
+
+		memset(&ct, 0, sizeof(compact_tree_t));
+		tree_init(&ctx, _s, 0, 0, 2*n);
+
+		failed = (tree_build(&ctx, bodies, n) != 0);
+
+		double t1 = now();
+
+		// the pointer tree is only needed until it is copied
+		if(method != POINTER){
+			if(!failed) failed = (tree_compact(&ctx, &ct) != 0);
+			if(!failed && method == MIXED) failed = (compact_mixed(&ct) != 0);
+			tree_free(&ctx);
+		}
+
+		walk_stats_reset();
+
+		double t2 = now();
+
+		if(!failed){
+			#pragma omp parallel for schedule(dynamic, 64)
+			for(size_t i=0; i<n; i++){
+				if(method == POINTER) tree_get_force(&ctx, bodies[i].x, bodies[i].y, bodies[i].mass, &fx[i], &fy[i], theta);
+				else if(method == MIXED) compact_get_force_mixed(&ct, bodies[i].x, bodies[i].y, bodies[i].mass, &fx[i], &fy[i], theta);
+					else compact_get_force(&ct, bodies[i].x, bodies[i].y, bodies[i].mass, &fx[i], &fy[i], theta);
+			}
+
+			r->build = t1 - t0;
+			r->convert = t2 - t1;
+			r->force = now() - t2;
+
+			if(method == POINTER) r->tree_kb = arena_bytes(&ctx.arena)/1024;
+			else{
+				compact_stats(&ct, &stats);
+				r->tree_kb = stats.bytes/1024;
+			}
+		}
+
+		if(method == POINTER) tree_free(&ctx);
+			else compact_free(&ct);
+	}
+
+	else{
+
+		linear_tree_t t;
+		tree_stats_t stats;
+
+		failed = (linear_tree_build_bodies(&t, bodies, n, _s, LT_LEAF_SIZE) != 0);
+
+		double t1 = now();
+
+		if(!failed && method == QUADRUPOLE) failed = (linear_tree_quadrupoles(&t) != 0);
+
+		walk_stats_reset();
+
+		double t2 = now();
+
+		if(!failed){
+			if(method == GROUP) failed = (get_forces_group(fx, fy, theta, GROUP_SIZE, &t) != 0);
+				else get_forces_linear(fx, fy, theta, &t);
+
+			r->build = t1 - t0;
+			r->convert = t2 - t1;
+			r->force = now() - t2;
+
+			linear_tree_stats(&t, &stats);
+			r->tree_kb = stats.bytes/1024;
+		}
+
+		linear_tree_free(&t);
+	}
+
+	if(!failed){
+
+		// a group walk counts its visits once for the group and
+		// its walks once for every body, so they are shared too
+		walk_stats_t walks;
+
+		walk_stats_read(&walks);
+		r->visits = (walks.walks > 0) ? (double) walks.visited/walks.walks : 0;
+
+		check_forces(bodies, n, fx, fy, sample, n_sample, r);
+	}
+
+	free(fx);
+	free(fy);
+
+	return failed ? -1 : 0;
+}
+
+
+int parse_list(const char *s, double *values, int max){
+	/*
+	reads the comma separated numbers of 's' in 'values'
+
+	returns the number of values read
+	returns -1 if 's' is not a list of at most 'max' positive numbers
+	*/
+
+	int count = 0;
+	char *end;
+
+	while(*s != '\0'){
+
+		if(count == max) return -1;
+
+		values[count] = strtod(s, &end);
+
+		if(end == s || !(values[count] > 0)) return -1;
+
+		count++;
+		s = end;
+
+		if(*s == ',') s++;
+			else if(*s != '\0') return -1;
+	}
+
+	return count;
+}
+
+
+int find_name(const char *s, const char **names, int count){
+	/*
+	returns the index of 's' in 'names', -1 if it is not there
+	*/
+
+	for(int k=0; k<count; k++){
+		if(strcmp(s, names[k]) == 0) return k;
+	}
+
+	return -1;
+}
+
+
+void usage(const char *name){
+	/*
+	prints the options of the program
+	*/
+
+	fprintf(stderr,
+		"usage: %s [-d uniform|plummer|clustered] [-n sizes] [-t thetas]\n"
+		"          [-m pointer|compact|mixed|linear|quadrupole|group] [-s seed] [-r radius] [-f csv|json]\n"
+		"  sizes and thetas are comma separated lists, e.g. -n 1e3,1e5 -t 0.3,0.5\n"
+		"  every distribution and method is run if not given, the radius of the\n"
+		"  universe (1000 by default) scales every coordinate, e.g. -r 1e25\n", name);
+}
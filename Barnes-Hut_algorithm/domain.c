@@ -0,0 +1,616 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "domain.h"
+#include "linear_tree.h"
+
+#define DOMAIN_BLOCK_NODES 4096 // nodes of the first block of the tree of a process
+
+// rectangle of the universe holding the bodies of a zone,
+// xmin > xmax if the zone has no body
+typedef struct domain_box {
+  double xmin, xmax;
+  double ymin, ymax;
+} domain_box_t;
+
+// state of the transport of 'transport_fork'
+typedef struct socket_data {
+  int *fd;    // fd[r] is the socket to the rank r, -1 for this process
+  pid_t *pid; // processes forked by the rank 0, 0 if not started
+} socket_data_t;
+
+// growing array of bodies
+typedef struct body_list {
+  body_t *bodies;
+  size_t n, cap;
+} body_list_t;
+
+
+int socket_send(transport_t *t, int to, const void *buf, size_t len);
+int socket_recv(transport_t *t, int from, void *buf, size_t len);
+void socket_close(transport_t *t);
+void cut_zones(const uint32_t *perm, const double *cost, size_t n, int size, size_t *zone);
+void zone_box(const uint32_t *perm, const double *x, const double *y, size_t begin, size_t end, domain_box_t *box);
+double box_distance(const domain_box_t *box, double x, double y);
+int essential_aux(const tree_ctx_t *ctx, const node_t *root, int h, const domain_box_t *box, double theta, body_list_t *list);
+int push_body(body_list_t *list, double x, double y, double m);
+int send_bodies(transport_t *t, int to, const body_list_t *list);
+int recv_bodies(transport_t *t, int from, body_list_t *list);
+int gather_forces(transport_t *t, const uint32_t *perm, const size_t *zone, const double *local, double *cost, double *fx, double *fy);
+
+
+int transport_fork(transport_t *t, int size){
+	/*
+	starts 'size' processes connected by Unix sockets, the calling
+	process being the rank 0
+
+	returns 0 in every process if they started succesfully
+	returns -1 (in the calling process only) otherwise
+	*/
+
+	memset(t, 0, sizeof(transport_t));
+
+	if(size < 1) return -1;
+
+	socket_data_t *data = malloc(sizeof(socket_data_t));
+	int *pairs = malloc(sizeof(int)*2*size*size);
+
+	if(data != NULL){
+		data->fd = malloc(sizeof(int)*size);
+		data->pid = calloc(size, sizeof(pid_t));
+	}
+
+	if(data == NULL || pairs == NULL || data->fd == NULL || data->pid == NULL){
+		if(data != NULL){
+			free(data->fd);
+			free(data->pid);
+		}
+		free(data);
+		free(pairs);
+		return -1;
+	}
+
+	// a pair of connected sockets for every two processes i < j,
+	// pairs[2*(i*size+j)] being the end of i and the next one the end of j
+	int failed = 0;
+
+	for(int k=0; k<2*size*size; k++){
+		pairs[k] = -1;
+	}
+
+	for(int i=0; i<size && !failed; i++){
+		for(int j=i+1; j<size && !failed; j++){
+			if(socketpair(AF_UNIX, SOCK_STREAM, 0, pairs + 2*(i*size+j)) != 0) failed = 1;
+		}
+	}
+
+	int rank = 0;
+
+	for(int r=1; r<size && !failed; r++){
+
+		pid_t pid = fork();
+
+		if(pid < 0) failed = 1;
+
+		else if(pid == 0){
+			rank = r;
+			break;
+		}
+
+		else data->pid[r] = pid;
+	}
+
+	// every process keeps its own ends only, so a process that
+	// ends is seen by the others as a closed socket
+	for(int i=0; i<size; i++){
+		for(int j=i+1; j<size; j++){
+
+			int *ends = pairs + 2*(i*size+j);
+
+			if(i == rank){
+				data->fd[j] = ends[0];
+				ends[0] = -1;
+			}
+
+			else if(j == rank){
+				data->fd[i] = ends[1];
+				ends[1] = -1;
+			}
+
+			if(ends[0] >= 0) close(ends[0]);
+			if(ends[1] >= 0) close(ends[1]);
+		}
+	}
+
+	data->fd[rank] = -1;
+	free(pairs);
+
+	t->rank = rank;
+	t->size = size;
+	t->send = socket_send;
+	t->recv = socket_recv;
+	t->close = socket_close;
+	t->data = data;
+
+	// only the rank 0 can get here with a failure,
+	// the processes already started find its sockets closed
+	if(failed){
+		transport_join(t, -1);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int transport_join(transport_t *t, int status){
+	/*
+	ends the processes started by 'transport_fork', the forked ones
+	exiting with 'status' and the rank 0 waiting for all of them
+
+	returns 0 if 'status' and the exit status of every process are 0
+	returns -1 otherwise
+	*/
+
+	socket_data_t *data = t->data;
+
+	if(t->rank != 0){
+		t->close(t);
+		_exit(status == 0 ? 0 : 1);
+	}
+
+	int size = t->size;
+	int failed = (status != 0);
+	pid_t *pid = data->pid;
+
+	// the sockets are closed first, so a process still
+	// waiting for the rank 0 gets an error instead of hanging
+	data->pid = NULL;
+	t->close(t);
+
+	for(int r=1; r<size; r++){
+
+		if(pid[r] <= 0) continue;
+
+		int st;
+		pid_t retval;
+
+		do{
+			retval = waitpid(pid[r], &st, 0);
+		}while(retval < 0 && errno == EINTR);
+
+		if(retval < 0 || !WIFEXITED(st) || WEXITSTATUS(st) != 0) failed = 1;
+	}
+
+	free(pid);
+
+	if(failed) return -1;
+
+	return 0;
+}
+
+
+int domain_forces(transport_t *t, const double *x, const double *y, const double *m, size_t n, double s, double theta, double *cost, double *fx, double *fy){
+	/*
+	calculates the forces on the n bodies sharing the work among the
+	processes of the transport, each one calling it with the same arguments
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	int rank = t->rank;
+	int size = t->size;
+
+	uint32_t *perm = malloc(sizeof(uint32_t)*(n > 0 ? n : 1));
+	size_t *zone = malloc(sizeof(size_t)*(size+1));
+	domain_box_t *box = malloc(sizeof(domain_box_t)*size);
+
+	body_list_t let = {NULL, 0, 0};
+	body_list_t remote = {NULL, 0, 0};
+	double *local = NULL;
+
+	tree_ctx_t ctx;
+	tree_init(&ctx, s, 0, 0, DOMAIN_BLOCK_NODES);
+
+	int failed = (perm == NULL || zone == NULL || box == NULL);
+
+	// every process finds the same zones on its own
+	// from the bodies, which all of them can read
+	if(!failed) failed = (morton_order(perm, x, y, n, s) != 0);
+
+	if(!failed){
+
+		cut_zones(perm, cost, n, size, zone);
+
+		for(int r=0; r<size; r++){
+			zone_box(perm, x, y, zone[r], zone[r+1], box + r);
+		}
+
+		for(size_t k=zone[rank]; k<zone[rank+1] && !failed; k++){
+			uint32_t i = perm[k];
+			if(tree_insert(&ctx, (long) i, m[i], x[i], y[i]) != 0) failed = 1;
+		}
+	}
+
+	// exchange of the locally essential trees, in rounds where the
+	// processes are matched in pairs (rank ^ k), so no two processes
+	// ever wait for each other; the parts received are inserted only
+	// at the end, so a process never sends the bodies of another one
+	int rounds = 1;
+
+	while(rounds < size) rounds *= 2;
+
+	for(int k=1; k<rounds && !failed; k++){
+
+		int partner = rank ^ k;
+
+		if(partner >= size) continue;
+
+		let.n = 0;
+
+		if(ctx.root != NULL && box[partner].xmin <= box[partner].xmax){
+			failed = (essential_aux(&ctx, ctx.root, 0, box + partner, theta, &let) != 0);
+		}
+
+		if(failed) break;
+
+		// the lower rank sends first
+		if(rank < partner) failed = (send_bodies(t, partner, &let) != 0 || recv_bodies(t, partner, &remote) != 0);
+			else failed = (recv_bodies(t, partner, &remote) != 0 || send_bodies(t, partner, &let) != 0);
+	}
+
+	for(size_t k=0; k<remote.n && !failed; k++){
+		const body_t *b = remote.bodies + k;
+		if(tree_insert(&ctx, -1, b->mass, b->x, b->y) != 0) failed = 1;
+	}
+
+	// forces and interactions of the bodies of the zone,
+	// stored as three consecutive arrays fx, fy, cost
+	if(!failed){
+
+		size_t count = zone[rank+1] - zone[rank];
+
+		local = malloc(sizeof(double)*3*(count > 0 ? count : 1));
+
+		if(local == NULL) failed = 1;
+
+		for(size_t j=0; j<count && !failed; j++){
+			uint32_t i = perm[zone[rank] + j];
+			local[2*count + j] = (double) tree_get_force(&ctx, x[i], y[i], m[i], local + j, local + count + j, theta);
+		}
+	}
+
+	if(!failed) failed = (gather_forces(t, perm, zone, local, cost, fx, fy) != 0);
+
+	tree_free(&ctx);
+	free(let.bodies);
+	free(remote.bodies);
+	free(local);
+	free(perm);
+	free(zone);
+	free(box);
+
+	if(failed) return -1;
+
+	return 0;
+}
+
+
+int forces_distributed(const double *x, const double *y, const double *m, size_t n, double s, double theta, int nproc, double *cost, double *fx, double *fy){
+	/*
+	same as 'domain_forces' on 'nproc' processes of this machine
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	transport_t t;
+
+	if(transport_fork(&t, nproc) != 0) return -1;
+
+	int retval = domain_forces(&t, x, y, m, n, s, theta, cost, fx, fy);
+
+	// the forked processes end here
+	return transport_join(&t, retval);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+int socket_send(transport_t *t, int to, const void *buf, size_t len){
+	/*
+	sends 'len' bytes to the rank 'to'
+
+	returns 0 if the bytes were sent succesfully
+	returns -1 otherwise, e.g. if the other process has ended
+	*/
+
+	const socket_data_t *data = t->data;
+	const char *p = buf;
+
+	if(to < 0 || to >= t->size || data->fd[to] < 0) return -1;
+
+	while(len > 0){
+
+		// no SIGPIPE if the other process has ended
+		ssize_t k = send(data->fd[to], p, len, MSG_NOSIGNAL);
+
+		if(k < 0 && errno == EINTR) continue;
+		if(k <= 0) return -1;
+
+		p += k;
+		len -= (size_t) k;
+	}
+
+	return 0;
+}
+
+
+int socket_recv(transport_t *t, int from, void *buf, size_t len){
+	/*
+	receives 'len' bytes from the rank 'from'
+
+	returns 0 if the bytes were received succesfully
+	returns -1 otherwise, e.g. if the other process has ended
+	*/
+
+	const socket_data_t *data = t->data;
+	char *p = buf;
+
+	if(from < 0 || from >= t->size || data->fd[from] < 0) return -1;
+
+	while(len > 0){
+
+		ssize_t k = recv(data->fd[from], p, len, 0);
+
+		if(k < 0 && errno == EINTR) continue;
+		if(k <= 0) return -1;
+
+		p += k;
+		len -= (size_t) k;
+	}
+
+	return 0;
+}
+
+
+void socket_close(transport_t *t){
+	/*
+	closes the sockets of the process
+	*/
+
+	socket_data_t *data = t->data;
+
+	if(data == NULL) return;
+
+	for(int r=0; r<t->size; r++){
+		if(data->fd[r] >= 0) close(data->fd[r]);
+	}
+
+	free(data->fd);
+	free(data->pid);
+	free(data);
+
+	t->data = NULL;
+}
+
+
+void cut_zones(const uint32_t *perm, const double *cost, size_t n, int size, size_t *zone){
+	/*
+	cuts the bodies sorted by 'perm' in 'size' contiguous zones of about
+	the same cost, the zone r being the sorted bodies from zone[r] to zone[r+1]
+	*/
+
+	double total = 0;
+
+	for(size_t k=0; k<n; k++){
+		total += (cost != NULL && cost[perm[k]] > 0) ? cost[perm[k]] : 1;
+	}
+
+	double sum = 0;
+	int r = 1;
+
+	zone[0] = 0;
+
+	for(size_t k=0; k<n && r<size; k++){
+
+		sum += (cost != NULL && cost[perm[k]] > 0) ? cost[perm[k]] : 1;
+
+		while(r < size && sum >= total*r/size){
+			zone[r++] = k+1;
+		}
+	}
+
+	while(r <= size) zone[r++] = n;
+}
+
+
+void zone_box(const uint32_t *perm, const double *x, const double *y, size_t begin, size_t end, domain_box_t *box){
+	/*
+	bounding box of the sorted bodies from 'begin' to 'end'
+	*/
+
+	box->xmin = box->ymin = INFINITY;
+	box->xmax = box->ymax = -INFINITY;
+
+	for(size_t k=begin; k<end; k++){
+
+		uint32_t i = perm[k];
+
+		if(x[i] < box->xmin) box->xmin = x[i];
+		if(x[i] > box->xmax) box->xmax = x[i];
+		if(y[i] < box->ymin) box->ymin = y[i];
+		if(y[i] > box->ymax) box->ymax = y[i];
+	}
+}
+
+
+double box_distance(const domain_box_t *box, double x, double y){
+	/*
+	distance of (x,y) from the closest point of the box, 0 if inside it
+	*/
+
+	double dx = (x < box->xmin) ? box->xmin - x : (x > box->xmax) ? x - box->xmax : 0;
+	double dy = (y < box->ymin) ? box->ymin - y : (y > box->ymax) ? y - box->ymax : 0;
+
+	return sqrt(dx*dx + dy*dy);
+}
+
+
+int essential_aux(const tree_ctx_t *ctx, const node_t *root, int h, const domain_box_t *box, double theta, body_list_t *list){
+	/*
+	appends to 'list' the part of the subtree of 'root', at depth h, needed
+	by the walks of the bodies in 'box': a node whose mass center satisfies
+	'theta' for every point of the box, as in 'get_force_aux', is sent as a
+	single point, otherwise it is opened down to the single bodies
+
+	returns 0 if the nodes were appended succesfully
+	returns -1 otherwise
+	*/
+
+	if(root == NULL || root->mass == 0) return 0;
+
+	int is_leaf = (root->NE == NULL && root->SE == NULL && root->SW == NULL && root->NW == NULL);
+	double d = box_distance(box, root->x, root->y);
+
+	if(is_leaf || (d > 0 && tree_node_size(ctx,h)/d < theta)) return push_body(list, root->x, root->y, root->mass);
+
+	if(essential_aux(ctx, root->NE, h+1, box, theta, list) != 0) return -1;
+	if(essential_aux(ctx, root->SE, h+1, box, theta, list) != 0) return -1;
+	if(essential_aux(ctx, root->SW, h+1, box, theta, list) != 0) return -1;
+	if(essential_aux(ctx, root->NW, h+1, box, theta, list) != 0) return -1;
+
+	return 0;
+}
+
+
+int push_body(body_list_t *list, double x, double y, double m){
+	/*
+	appends a body to the list, doubling its capacity when full
+
+	returns 0 if the body was appended succesfully
+	returns -1 otherwise
+	*/
+
+	if(list->n == list->cap){
+
+		size_t cap = (list->cap == 0) ? 1024 : 2*list->cap;
+		body_t *temp = realloc(list->bodies, sizeof(body_t)*cap);
+
+		if(temp == NULL) return -1;
+
+		list->bodies = temp;
+		list->cap = cap;
+	}
+
+	list->bodies[list->n].x = x;
+	list->bodies[list->n].y = y;
+	list->bodies[list->n].mass = m;
+	list->n++;
+
+	return 0;
+}
+
+
+int send_bodies(transport_t *t, int to, const body_list_t *list){
+	/*
+	sends the number of bodies of the list followed by the bodies
+
+	returns 0 if the list was sent succesfully
+	returns -1 otherwise
+	*/
+
+	uint64_t count = list->n;
+
+	if(t->send(t, to, &count, sizeof(count)) != 0) return -1;
+
+	if(count == 0) return 0;
+
+	return t->send(t, to, list->bodies, sizeof(body_t)*list->n);
+}
+
+
+int recv_bodies(transport_t *t, int from, body_list_t *list){
+	/*
+	receives a list sent by 'send_bodies', appending its bodies to 'list'
+
+	returns 0 if the list was received succesfully
+	returns -1 otherwise
+	*/
+
+	uint64_t count;
+
+	if(t->recv(t, from, &count, sizeof(count)) != 0) return -1;
+
+	if(count == 0) return 0;
+
+	if(list->n + count > list->cap){
+
+		body_t *temp = realloc(list->bodies, sizeof(body_t)*(list->n + count));
+
+		if(temp == NULL) return -1;
+
+		list->bodies = temp;
+		list->cap = list->n + count;
+	}
+
+	if(t->recv(t, from, list->bodies + list->n, sizeof(body_t)*count) != 0) return -1;
+
+	list->n += count;
+
+	return 0;
+}
+
+
+int gather_forces(transport_t *t, const uint32_t *perm, const size_t *zone, const double *local, double *cost, double *fx, double *fy){
+	/*
+	collects in the rank 0 the forces and the interactions of every zone,
+	'local' holding the ones of the zone of the process, and puts them in
+	the original order of the bodies
+
+	returns 0 if the forces were collected succesfully
+	returns -1 otherwise
+	*/
+
+	int rank = t->rank;
+
+	if(rank != 0) return t->send(t, 0, local, sizeof(double)*3*(zone[rank+1] - zone[rank]));
+
+	for(int r=0; r<t->size; r++){
+
+		size_t count = zone[r+1] - zone[r];
+		const double *buf = local;
+		double *temp = NULL;
+
+		if(r != 0){
+
+			temp = malloc(sizeof(double)*3*(count > 0 ? count : 1));
+
+			if(temp == NULL || t->recv(t, r, temp, sizeof(double)*3*count) != 0){
+				free(temp);
+				return -1;
+			}
+
+			buf = temp;
+		}
+
+		for(size_t j=0; j<count; j++){
+
+			uint32_t i = perm[zone[r] + j];
+
+			fx[i] = buf[j];
+			fy[i] = buf[count + j];
+			if(cost != NULL) cost[i] = buf[2*count + j];
+		}
+
+		free(temp);
+	}
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef __DOMAIN__H
+#define __DOMAIN__H
+#include <stddef.h>
+#include "barnes_static.h"
+
+
+// channel between the processes of a distributed calculation
+//
+// the calculation only sends and receives blocks of bytes through the
+// functions of the transport, so it runs on any implementation of them
+// (e.g. the Unix sockets of 'transport_fork', or MPI)
+typedef struct transport {
+
+  // this process, from 0 to size-1, and number of processes
+  int rank;
+  int size;
+
+  // sends/receives 'len' bytes to/from the process 'to'/'from',
+  // returning 0 if succesfull and -1 otherwise
+  int (*send)(struct transport *t, int to, const void *buf, size_t len);
+  int (*recv)(struct transport *t, int from, void *buf, size_t len);
+
+  // releases the channel
+  void (*close)(struct transport *t);
+
+  // state of the implementation
+  void *data;
+} transport_t;
+
+
+	/*
+	starts 'size' processes on this machine connected by Unix sockets: the
+	calling process becomes the rank 0 and size-1 copies of it are forked
+	with ranks 1, ..., size-1, every process returning from the call with
+	its own end of the transport
+
+	the forked processes share the memory of the caller as it was at the
+	time of the call (copy on write), e.g. the bodies of a mapped snapshot,
+	and must end with 'transport_join'; they should not use OpenMP, whose
+	threads are not copied by the fork
+
+	returns 0 in every process if they started succesfully
+	returns -1 (in the calling process only) otherwise
+	*/
+int transport_fork (transport_t * t, int size);
+
+
+	/*
+	ends the processes started by 'transport_fork': a forked process
+	closes its transport and exits with 'status', never returning, the
+	rank 0 closes its transport and waits for all the others
+
+	returns 0 if 'status' and the exit status of every process are 0
+	returns -1 otherwise
+	*/
+int transport_join (transport_t * t, int status);
+
+
+	/*
+	calculates the forces on the n bodies (x[i],y[i]) of mass m[i] in the
+	universe of radius s centered in the origin, the work being shared by
+	all the processes of the transport, each one calling it with the same
+	arguments (only the rank 0 needs 'fx' and 'fy')
+
+	the bodies are sorted along the Z-order curve, which is cut in as many
+	contiguous zones as the processes, of equal total cost (costzones), the
+	cost of a body being cost[i] or 1 if 'cost' is NULL; every process builds
+	the tree of its zone with 'tree_insert', sends to every other process
+	the part of it that the walks of its bodies would open (its locally
+	essential tree: single bodies, or nodes satisfying 'theta' for the whole
+	box of the other zone), and inserts the parts received from the others
+	in its tree before calculating the forces of its bodies by 'tree_get_force'
+
+	the forces are gathered by the rank 0 in fx, fy, and in cost[i] the
+	interactions of the i-th body, i.e. the cost to use for the next step;
+	the forces differ from the ones of a single tree of all the bodies only
+	within the approximation given by 'theta', but they are not the same
+	bit for bit: a cell shared by several other zones reaches a process as
+	one node from each of them, which its walks cannot open as deep as the
+	walk of the single tree (e.g. for uniform bodies they agree to rounding
+	up to 7 processes and differ by up to 1e-1 relative from 8 on, with the
+	same error against the exact forces)
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+int domain_forces (transport_t * t, const double * x, const double * y, const double * m, size_t n, double s, double theta, double * cost, double * fx, double * fy);
+
+
+	/*
+	same as 'domain_forces' on 'nproc' processes of this machine
+	started by 'transport_fork', the results being in the arrays of
+	the caller
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+int forces_distributed (const double * x, const double * y, const double * m, size_t n, double s, double theta, int nproc, double * cost, double * fx, double * fy);
+#endif
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "linear_tree.h"
+#include "pp_kernel.h"
+
+
+// interaction list shared by the bodies of a group: the point masses
+// (bodies of the opened leaves and accepted nodes) stored as contiguous
+// arrays, and the accepted nodes for the quadrupole corrections
+typedef struct ilist {
+  size_t n, cap;
+  double *x, *y, *m;
+  size_t n_quad, cap_quad;
+  uint32_t *quad;
+} ilist_t;
+
+
+size_t find_groups(const linear_tree_t *t, int group_size, uint32_t *groups);
+int group_walk(const linear_tree_t *t, const lnode_t *group, double theta, ilist_t *list);
+int ilist_push(ilist_t *list, double x, double y, double m);
+void ilist_free(ilist_t *list);
+
+
+int linear_tree_build(linear_tree_t *t, const double *x, const double *y, const double *m, size_t n, double s, int leaf_size){
+	/*
+	builds the linear quadtree of the n bodies of coordinates (x[i],y[i])
+	and masses m[i] in the universe of radius s (fitted to the bodies if
+	s <= 0), a node is split only if it holds more than 'leaf_size' bodies
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	const double *xs[2] = {x, y};
+
+	return ntree2_build_strided(t, xs, m, 1, n, s, leaf_size);
+}
+
+
+int linear_tree_build_bodies(linear_tree_t *t, const body_t *bodies, size_t n, double s, int leaf_size){
+	/*
+	same as 'linear_tree_build' for an array of bodies
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	const double *xs[2] = {&bodies->x, &bodies->y};
+
+	return ntree2_build_strided(t, xs, &bodies->mass, sizeof(body_t)/sizeof(double), n, s, leaf_size);
+}
+
+
+int linear_tree_build_sorted(linear_tree_t *t, const double *x, const double *y, const double *m, size_t n, double s, int leaf_size){
+	/*
+	builds the linear quadtree of the n bodies already sorted along
+	the Z-order curve of the universe of radius s, using the arrays
+	x, y, m in place
+
+	returns 0 if the tree was built succesfully
+	returns -1 if the bodies are not sorted or the allocation failed
+	*/
+
+	const double *xs[2] = {x, y};
+
+	return ntree2_build_sorted(t, xs, m, n, s, leaf_size);
+}
+
+
+void linear_tree_free(linear_tree_t *t){
+	/*
+	deallocates the linear quadtree
+	*/
+
+	ntree2_free(t);
+}
+
+
+uint64_t morton_key(double x, double y, double s){
+	/*
+	returns the Z-order key of the point (x,y) in a universe of radius s
+
+	the two bits of level h (from the most significant) are
+	(east, north) as chosen by 'get_quadrant': a body on the vertical
+	border of a quadrant goes west, one on the horizontal border goes north
+	*/
+
+	double p[2] = {x, y};
+
+	return ntree2_key(p, s);
+}
+
+
+int morton_order(uint32_t *perm, const double *x, const double *y, size_t n, double s){
+	/*
+	sorts the n points (x[i],y[i]) along the Z-order curve
+	of the universe of radius s
+
+	returns 0 if the points were sorted succesfully
+	returns -1 otherwise
+	*/
+
+	const double *xs[2] = {x, y};
+
+	return ntree2_order(perm, xs, n, s);
+}
+
+
+double get_mass_linear(double x, double y, const linear_tree_t *t){
+	/*
+	returns mass of the body in (x,y)
+
+	else returns 0 if body of coordinates (x,y)
+	is not in the tree
+	*/
+
+	double p[2] = {x, y};
+
+	return ntree2_get_mass(p, t);
+}
+
+
+void linear_tree_stats(const linear_tree_t *t, tree_stats_t *stats){
+	/*
+	shape and memory of the linear quadtree
+	*/
+
+	ntree2_stats(t, stats);
+}
+
+
+void get_force_linear(double x, double y, double *fx, double *fy, double theta, const linear_tree_t *t){
+	/*
+	calculates the components (fx,fy) of the force on the particle of coordinates (x,y)
+	given a tollerance 'theta'
+	*/
+
+	double p[2] = {x, y};
+	double f[2];
+
+	ntree2_get_force(p, f, theta, t);
+
+	*fx = f[0];
+	*fy = f[1];
+}
+
+
+void get_forces_linear(double fx[], double fy[], double theta, const linear_tree_t *t){
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta',
+	(fx[i],fy[i]) is the force on the i-th body in the order used to build the tree
+	*/
+
+	double *f[2] = {fx, fy};
+
+	ntree2_get_forces_split(f, theta, t);
+}
+
+
+int get_forces_group(double fx[], double fy[], double theta, int group_size, const linear_tree_t *t){
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta'
+	walking the tree once for every group of at most 'group_size' neighbouring
+	bodies, (fx[i],fy[i]) is the force on the i-th body in the order used to
+	build the tree
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	if(t->n_nodes == 0) return 0;
+
+	uint32_t *groups = malloc(sizeof(uint32_t)*t->n_nodes);
+	if(groups == NULL) return -1;
+
+	size_t n_groups = find_groups(t, group_size, groups);
+	const double *x = t->x[0], *y = t->x[1];
+	int failed = 0;
+
+	#pragma omp parallel
+	{
+		ilist_t list;
+		memset(&list, 0, sizeof(ilist_t));
+
+		// groups in dense regions have longer lists, they are
+		// handed out dynamically to balance the threads
+		#pragma omp for schedule(dynamic, 4)
+		for(size_t g=0; g<n_groups; g++){
+
+			const lnode_t *group = t->nodes + groups[g];
+
+			if(group_walk(t, group, theta, &list) != 0){
+				#pragma omp atomic write
+				failed = 1;
+				continue;
+			}
+
+			// the same list for every body of the group, the body itself
+			// is in the list at zero distance and is skipped by the kernel
+			for(uint32_t i=group->begin; i<group->end; i++){
+
+				double ax = 0, ay = 0;
+
+				pp_kernel(x[i], y[i], list.x, list.y, list.m, list.n, &ax, &ay);
+
+				double f[2] = {G*t->m[i]*ax, G*t->m[i]*ay};
+
+				for(size_t k=0; k<list.n_quad; k++){
+
+					const lnode_t *node = t->nodes + list.quad[k];
+					double D[2] = {node->x[0] - x[i], node->x[1] - y[i]};
+					double d = sqrt(D[0]*D[0] + D[1]*D[1]);
+
+					ntree2_quadrupole_force(D, d, t->m[i], t->quad + 3*(size_t) list.quad[k], f);
+				}
+
+				fx[t->perm[i]] = f[0];
+				fy[t->perm[i]] = f[1];
+			}
+		}
+
+		ilist_free(&list);
+		WALK_FLUSH();
+	}
+
+	free(groups);
+
+	return failed ? -1 : 0;
+}
+
+
+int get_forces_all(const body_t *bodies, size_t n, double theta, double fx[], double fy[]){
+	/*
+	calculates the force (fx[i],fy[i]) on every body bodies[i]
+	given a tollerance 'theta'
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	linear_tree_t t;
+
+	if(linear_tree_build_bodies(&t, bodies, n, 0, LT_LEAF_SIZE) != 0) return -1;
+
+	get_forces_linear(fx, fy, theta, &t);
+
+	linear_tree_free(&t);
+
+	return 0;
+}
+
+
+int linear_tree_quadrupoles(linear_tree_t *t){
+	/*
+	quadrupole moments (Qxx, Qxy, Qyy) of every node with respect to its
+	mass center, used by the walks for the nodes approximated as a single point
+
+	returns 0 if the moments were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	return ntree2_quadrupoles(t);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+size_t find_groups(const linear_tree_t *t, int group_size, uint32_t *groups){
+	/*
+	stores in 'groups' the largest nodes holding at most 'group_size'
+	bodies (or leaves), which together hold every body once
+
+	returns the number of groups
+	*/
+
+	uint32_t stack[4*(LT_LEVELS+2)];
+	int top = 0;
+	size_t n_groups = 0;
+
+	stack[top++] = 0;
+
+	while(top > 0){
+
+		uint32_t k = stack[--top];
+		const lnode_t *node = t->nodes + k;
+
+		if(node->nchild == 0 || node->end - node->begin <= (uint32_t) group_size){
+			groups[n_groups++] = k;
+			continue;
+		}
+
+		for(int c=node->nchild-1; c>=0; c--){
+			stack[top++] = node->first + c;
+		}
+	}
+
+	return n_groups;
+}
+
+
+int group_walk(const linear_tree_t *t, const lnode_t *group, double theta, ilist_t *list){
+	/*
+	builds the interaction list of the bodies of 'group' walking the tree
+	against the bounding box of the group: a node is approximated as a
+	single point only if it satisfies the tollerance 'theta' for the point
+	of the box closest to it, i.e. for every body of the group
+
+	returns 0 if the list was built succesfully
+	returns -1 otherwise
+	*/
+
+	list->n = 0;
+	list->n_quad = 0;
+
+	const double *x = t->x[0], *y = t->x[1];
+
+	// bounding box of the bodies of the group
+	double xmin = x[group->begin], xmax = xmin;
+	double ymin = y[group->begin], ymax = ymin;
+
+	for(uint32_t i=group->begin+1; i<group->end; i++){
+		if(x[i] < xmin) xmin = x[i];
+		if(x[i] > xmax) xmax = x[i];
+		if(y[i] < ymin) ymin = y[i];
+		if(y[i] > ymax) ymax = y[i];
+	}
+
+	// the list is shared by the bodies of the group, each of
+	// them counts the interactions with every element
+	size_t bodies = group->end - group->begin;
+
+	uint32_t stack[4*(LT_LEVELS+2)];
+	int top = 0;
+
+	stack[top++] = 0;
+	WALK_COUNT(walks, bodies);
+
+	while(top > 0){
+
+		uint32_t k = stack[--top];
+		const lnode_t *node = t->nodes + k;
+
+		WALK_COUNT(visited, 1);
+
+		// empty node
+		if(node->mass == 0) continue;
+
+		// distance between the mass center and the box
+		double Dx = (node->x[0] < xmin) ? xmin - node->x[0] : (node->x[0] > xmax) ? node->x[0] - xmax : 0;
+		double Dy = (node->x[1] < ymin) ? ymin - node->x[1] : (node->x[1] > ymax) ? node->x[1] - ymax : 0;
+		double d = sqrt(Dx*Dx + Dy*Dy);
+
+		// the group itself and its ancestors are always opened
+		int overlap = (node->begin < group->end && group->begin < node->end);
+
+		if(!overlap && d > 0 && t->size[node->level]/d < theta){
+
+			WALK_COUNT(accepted, bodies);
+
+			if(ilist_push(list, node->x[0], node->x[1], node->mass) != 0) return -1;
+
+			if(t->quad != NULL){
+
+				if(list->n_quad == list->cap_quad){
+					size_t cap = (list->cap_quad == 0) ? 64 : 2*list->cap_quad;
+					uint32_t *temp = realloc(list->quad, sizeof(uint32_t)*cap);
+					if(temp == NULL) return -1;
+					list->quad = temp;
+					list->cap_quad = cap;
+				}
+
+				list->quad[list->n_quad++] = k;
+			}
+
+			continue;
+		}
+
+		// leaf opened, its bodies join the direct sum
+		if(node->nchild == 0){
+			WALK_COUNT(leaf, bodies*(node->end - node->begin));
+			for(uint32_t j=node->begin; j<node->end; j++){
+				if(ilist_push(list, x[j], y[j], t->m[j]) != 0) return -1;
+			}
+			continue;
+		}
+
+		for(int c=node->nchild-1; c>=0; c--){
+			stack[top++] = node->first + c;
+		}
+	}
+
+	return 0;
+}
+
+
+int ilist_push(ilist_t *list, double x, double y, double m){
+	/*
+	appends a point mass to the interaction list
+
+	returns 0 if the point was added succesfully
+	returns -1 otherwise
+	*/
+
+	if(list->n == list->cap){
+
+		size_t cap = (list->cap == 0) ? 256 : 2*list->cap;
+		double *tx = realloc(list->x, sizeof(double)*cap);
+		if(tx == NULL) return -1;
+		list->x = tx;
+		double *ty = realloc(list->y, sizeof(double)*cap);
+		if(ty == NULL) return -1;
+		list->y = ty;
+		double *tm = realloc(list->m, sizeof(double)*cap);
+		if(tm == NULL) return -1;
+		list->m = tm;
+
+		list->cap = cap;
+	}
+
+	list->x[list->n] = x;
+	list->y[list->n] = y;
+	list->m[list->n] = m;
+	list->n++;
+
+	return 0;
+}
+
+
+void ilist_free(ilist_t *list){
+	/*
+	deallocates the interaction list
+	*/
+
+	free(list->x);
+	free(list->y);
+	free(list->m);
+	free(list->quad);
+}
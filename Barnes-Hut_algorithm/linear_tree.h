@@ -0,0 +1,154 @@
+#ifndef __LINEAR_TREE__H
+#define __LINEAR_TREE__H
+#include <stddef.h>
+#include <stdint.h>
+#include "barnes_static.h"
+#include "ntree.h"
+
+
+// the linear quadtree is the 2 dimensional tree of 'ntree.h': the functions
+// below take the coordinates as separate arrays x, y and components fx, fy,
+// the sorted coordinates of the tree being t->x[0], t->x[1] and the mass
+// center of a node node->x[0], node->x[1]
+
+// number of levels resolved by the Morton keys, i.e. bits per coordinate
+#define LT_LEVELS NT_LEVELS
+
+// default number of bodies in a leaf used by 'get_forces_all'
+#define LT_LEAF_SIZE NT_LEAF_SIZE
+
+// node of the linear quadtree, a square of radius s/2^level
+typedef ntree2_node_t lnode_t;
+
+// pointerless quadtree built from the Morton (Z-order) sorted bodies
+typedef ntree2_t linear_tree_t;
+
+
+	/*
+	builds the linear quadtree of the n bodies of coordinates (x[i],y[i])
+	and masses m[i] in the universe of radius s centered in the origin,
+	or in the smallest one holding the bodies if s <= 0
+
+	a node is split only if it holds more than 'leaf_size' bodies (1 gives
+	the same tree of 'insert'), the bodies of a leaf are then evaluated
+	by direct summation with a vectorized kernel when the leaf is opened
+
+	the bodies are sorted by Morton key with a radix sort and the
+	tree is built on the sorted arrays, the mass centers are then
+	accumulated bottom-up
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+int linear_tree_build (linear_tree_t * t, const double * x, const double * y, const double * m, size_t n, double s, int leaf_size);
+
+
+	/*
+	same as 'linear_tree_build' for an array of bodies
+	*/
+int linear_tree_build_bodies (linear_tree_t * t, const body_t * bodies, size_t n, double s, int leaf_size);
+
+
+	/*
+	same as 'linear_tree_build' for bodies already sorted along the Z-order
+	curve of the universe of radius s (e.g. by 'morton_order'): there is
+	nothing to sort and the tree uses the arrays in place instead of
+	copying them, so they must outlive the tree
+
+	returns 0 if the tree was built succesfully
+	returns -1 if the bodies are not sorted, s <= 0 or the allocation failed
+	*/
+int linear_tree_build_sorted (linear_tree_t * t, const double * x, const double * y, const double * m, size_t n, double s, int leaf_size);
+
+
+	/*
+	deallocates the linear quadtree
+	*/
+void linear_tree_free (linear_tree_t * t);
+
+
+	/*
+	quadrupole moments of every node with respect to its mass center,
+	accumulated bottom-up; once computed they are used by the walks for
+	the nodes approximated as a single point, which reach the same
+	accuracy with a larger 'theta'
+
+	returns 0 if the moments were calculated succesfully
+	returns -1 otherwise
+	*/
+int linear_tree_quadrupoles (linear_tree_t * t);
+
+
+	/*
+	same as 'tree_stats' for the linear quadtree, every body of a leaf
+	being counted, the memory being the one of the nodes, the sorted
+	bodies and the moments
+	*/
+void linear_tree_stats (const linear_tree_t * t, tree_stats_t * stats);
+
+
+	/*
+	returns the Z-order key of the point (x,y) in a universe of radius s,
+	the quadrants are chosen with the same convention of 'insert'
+	*/
+uint64_t morton_key (double x, double y, double s);
+
+
+	/*
+	sorts the n points (x[i],y[i]) along the Z-order curve of the universe
+	of radius s, perm[k] being the index of the k-th point of the curve
+
+	returns 0 if the points were sorted succesfully
+	returns -1 otherwise
+	*/
+int morton_order (uint32_t * perm, const double * x, const double * y, size_t n, double s);
+
+
+	/*
+	same as 'get_mass' on the linear quadtree
+	*/
+double get_mass_linear (double x, double y, const linear_tree_t * t);
+
+
+	/*
+	same as 'get_force' on the linear quadtree
+	*/
+void get_force_linear (double x, double y, double *fx, double *fy, double theta, const linear_tree_t * t);
+
+
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta',
+	(fx[i],fy[i]) is the force on the i-th body in the order used to build the tree
+
+	the bodies are known by index, so there is no lookup, and the walks
+	are spread over the threads (if compiled with OpenMP)
+	*/
+void get_forces_linear (double fx[], double fy[], double theta, const linear_tree_t * t);
+
+
+	/*
+	same as 'get_forces_linear' but the tree is walked once for every group
+	of at most 'group_size' neighbouring bodies (a node of the tree) instead
+	of once for every body
+
+	a node is approximated as a single point only if it satisfies 'theta'
+	for the whole bounding box of the group, the walk builds an interaction
+	list of point masses shared by the bodies of the group, which is then
+	evaluated for every body with the vectorized kernel
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+int get_forces_group (double fx[], double fy[], double theta, int group_size, const linear_tree_t * t);
+
+
+	/*
+	calculates the force (fx[i],fy[i]) on every body bodies[i] given a
+	tollerance 'theta', building a linear quadtree with 'LT_LEAF_SIZE' bodies
+	per leaf in the smallest universe holding them and calling 'get_forces_linear'
+
+	returns 0 if the forces were calculated succesfully
+	returns -1 otherwise
+	*/
+int get_forces_all (const body_t * bodies, size_t n, double theta, double fx[], double fy[]);
+#endif
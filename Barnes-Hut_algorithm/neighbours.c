@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "neighbours.h"
+
+// state of a query
+typedef struct query {
+
+  const tree_ctx_t *ctx;
+
+  // query point, and id of the body to leave out (-1 for none)
+  double x, y;
+  long skip;
+
+  // radius of a range query
+  double r;
+
+  // bodies found, the first 'max' being stored in 'out' by a range
+  // query, while a k-nearest query keeps in 'out' a max-heap of the
+  // k closest ones found so far
+  neighbour_t *out;
+  size_t max;
+  size_t count;
+  int k;
+} query_t;
+
+
+void range_aux(query_t *q, const node_t *root, double x0, double y0, int h);
+void knn_aux(query_t *q, const node_t *root, double x0, double y0, int h);
+double cell_distance(double x, double y, double x0, double y0, double size);
+void heap_push(neighbour_t *heap, int *count, int k, const neighbour_t *nb);
+void heap_sort(neighbour_t *heap, int count);
+void sift_down(neighbour_t *heap, int i, int count);
+void init_query(query_t *q, const tree_ctx_t *ctx, double x, double y, long skip);
+
+
+size_t tree_range(const tree_ctx_t *ctx, double x, double y, double r, neighbour_t *out, size_t max){
+	/*
+	finds the bodies of the tree at distance <= r from (x,y), storing
+	the first 'max' of them in 'out'
+
+	returns the number of bodies found, which may be more than 'max'
+	*/
+
+	query_t q;
+
+	init_query(&q, ctx, x, y, -1);
+	q.r = r;
+	q.out = out;
+	q.max = max;
+
+	range_aux(&q, ctx->root, ctx->cx, ctx->cy, 0);
+
+	return q.count;
+}
+
+
+int tree_knn(const tree_ctx_t *ctx, double x, double y, int k, neighbour_t *out){
+	/*
+	finds the k bodies of the tree closest to (x,y), from the closest
+
+	returns the number of bodies found
+	*/
+
+	if(k <= 0) return 0;
+
+	query_t q;
+
+	init_query(&q, ctx, x, y, -1);
+	q.out = out;
+	q.k = k;
+
+	knn_aux(&q, ctx->root, ctx->cx, ctx->cy, 0);
+	heap_sort(out, (int) q.count);
+
+	return (int) q.count;
+}
+
+
+neighbour_t* tree_range_all(const tree_ctx_t *ctx, const body_t *bodies, size_t n, double r, size_t *offset){
+	/*
+	finds for every one of the n bodies the bodies of the tree
+	within distance r from it, the body itself (of id i) excluded
+
+	returns the array of the neighbours, bodies[i] having the ones from
+	offset[i] to offset[i+1]
+	returns NULL if the allocation failed
+	*/
+
+	offset[0] = 0;
+
+	// first the neighbours are only counted, so each
+	// body can then write its own ones in place
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t i=0; i<n; i++){
+
+		query_t q;
+
+		init_query(&q, ctx, bodies[i].x, bodies[i].y, (long) i);
+		q.r = r;
+
+		range_aux(&q, ctx->root, ctx->cx, ctx->cy, 0);
+
+		offset[i+1] = q.count;
+	}
+
+	for(size_t i=0; i<n; i++){
+		offset[i+1] += offset[i];
+	}
+
+	neighbour_t *out = malloc(sizeof(neighbour_t)*(offset[n] > 0 ? offset[n] : 1));
+
+	if(out == NULL) return NULL;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t i=0; i<n; i++){
+
+		query_t q;
+
+		init_query(&q, ctx, bodies[i].x, bodies[i].y, (long) i);
+		q.r = r;
+		q.out = out + offset[i];
+		q.max = offset[i+1] - offset[i];
+
+		range_aux(&q, ctx->root, ctx->cx, ctx->cy, 0);
+	}
+
+	return out;
+}
+
+
+int tree_knn_all(const tree_ctx_t *ctx, const body_t *bodies, size_t n, int k, neighbour_t *out){
+	/*
+	finds for every one of the n bodies the k closest bodies of the
+	tree, the body itself (of id i) excluded, in out[i*k],...,out[i*k+k-1]
+
+	returns 0 if the neighbours were found succesfully
+	returns -1 otherwise
+	*/
+
+	if(k < 0) return -1;
+	if(k == 0) return 0;
+
+	#pragma omp parallel for schedule(dynamic, 64)
+	for(size_t i=0; i<n; i++){
+
+		neighbour_t *nb = out + i*(size_t) k;
+		query_t q;
+
+		init_query(&q, ctx, bodies[i].x, bodies[i].y, (long) i);
+		q.out = nb;
+		q.k = k;
+
+		knn_aux(&q, ctx->root, ctx->cx, ctx->cy, 0);
+		heap_sort(nb, (int) q.count);
+
+		for(int j=(int) q.count; j<k; j++){
+			nb[j].id = -1;
+			nb[j].x = nb[j].y = nb[j].mass = 0;
+			nb[j].d = INFINITY;
+		}
+	}
+
+	return 0;
+}
+
+
+size_t range_search(double x, double y, double r, neighbour_t *out, size_t max, node_t *root){
+	/*
+	same as 'tree_range' for a tree in the universe of radius '_s'
+	*/
+
+	tree_ctx_t view;
+
+	memset(&view, 0, sizeof(tree_ctx_t));
+	tree_set_universe(&view, _s, 0, 0);
+	view.root = root;
+
+	return tree_range(&view, x, y, r, out, max);
+}
+
+
+int knn_search(double x, double y, int k, neighbour_t *out, node_t *root){
+	/*
+	same as 'tree_knn' for a tree in the universe of radius '_s'
+	*/
+
+	tree_ctx_t view;
+
+	memset(&view, 0, sizeof(tree_ctx_t));
+	tree_set_universe(&view, _s, 0, 0);
+	view.root = root;
+
+	return tree_knn(&view, x, y, k, out);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+void init_query(query_t *q, const tree_ctx_t *ctx, double x, double y, long skip){
+	/*
+	initializes a query from (x,y) with nothing found yet, the
+	body of id 'skip' (if not negative) being left out
+	*/
+
+	memset(q, 0, sizeof(query_t));
+
+	q->ctx = ctx;
+	q->x = x;
+	q->y = y;
+	q->skip = skip;
+}
+
+
+void range_aux(query_t *q, const node_t *root, double x0, double y0, int h){
+	/*
+	adds to the query the bodies within its radius in the subtree of
+	'root', at depth h and with geometrical center (x0,y0)
+	*/
+
+	if(root == NULL || root->mass == 0) return;
+
+	// leaf, i.e. a body
+	if(root->NE == NULL && root->SE == NULL && root->SW == NULL && root->NW == NULL){
+
+		if(q->skip >= 0 && root->id == q->skip) return;
+
+		double dx = root->x - q->x;
+		double dy = root->y - q->y;
+		double d = sqrt(dx*dx + dy*dy);
+
+		if(d > q->r) return;
+
+		if(q->count < q->max){
+			neighbour_t *nb = q->out + q->count;
+			nb->id = root->id;
+			nb->x = root->x;
+			nb->y = root->y;
+			nb->mass = root->mass;
+			nb->d = d;
+		}
+
+		q->count++;
+		return;
+	}
+
+	// no point of the quadrant is close enough
+	if(cell_distance(q->x, q->y, x0, y0, tree_node_size(q->ctx,h)) > q->r) return;
+
+	double c = tree_node_size(q->ctx,h+1);
+
+	range_aux(q, root->NE, x0+c, y0+c, h+1);
+	range_aux(q, root->SE, x0+c, y0-c, h+1);
+	range_aux(q, root->SW, x0-c, y0-c, h+1);
+	range_aux(q, root->NW, x0-c, y0+c, h+1);
+}
+
+
+void knn_aux(query_t *q, const node_t *root, double x0, double y0, int h){
+	/*
+	adds to the query the bodies of the subtree of 'root', at depth h and
+	with geometrical center (x0,y0), closer than the k-th one found so far
+	*/
+
+	if(root == NULL || root->mass == 0) return;
+
+	int count = (int) q->count;
+
+	if(root->NE == NULL && root->SE == NULL && root->SW == NULL && root->NW == NULL){
+
+		if(q->skip >= 0 && root->id == q->skip) return;
+
+		double dx = root->x - q->x;
+		double dy = root->y - q->y;
+		neighbour_t nb;
+
+		nb.id = root->id;
+		nb.x = root->x;
+		nb.y = root->y;
+		nb.mass = root->mass;
+		nb.d = sqrt(dx*dx + dy*dy);
+
+		heap_push(q->out, &count, q->k, &nb);
+		q->count = (size_t) count;
+		return;
+	}
+
+	// the root of the heap is the farthest of the k bodies found
+	if(count == q->k && cell_distance(q->x, q->y, x0, y0, tree_node_size(q->ctx,h)) > q->out[0].d) return;
+
+	// the quadrants are entered from the closest one, so
+	// the farther ones are more likely to be skipped
+	double c = tree_node_size(q->ctx,h+1);
+	const node_t *child[4] = {root->NE, root->SE, root->SW, root->NW};
+	double cx[4] = {x0+c, x0+c, x0-c, x0-c};
+	double cy[4] = {y0+c, y0-c, y0-c, y0+c};
+	double dist[4];
+	int order[4];
+
+	for(int i=0; i<4; i++){
+
+		dist[i] = cell_distance(q->x, q->y, cx[i], cy[i], c);
+
+		int j = i;
+
+		while(j > 0 && dist[order[j-1]] > dist[i]){
+			order[j] = order[j-1];
+			j--;
+		}
+
+		order[j] = i;
+	}
+
+	for(int i=0; i<4; i++){
+		int j = order[i];
+		knn_aux(q, child[j], cx[j], cy[j], h+1);
+	}
+}
+
+
+double cell_distance(double x, double y, double x0, double y0, double size){
+	/*
+	distance of (x,y) from the closest point of the square of
+	radius 'size' centered in (x0,y0), 0 if inside it
+	*/
+
+	double dx = fabs(x - x0) - size;
+	double dy = fabs(y - y0) - size;
+
+	if(dx < 0) dx = 0;
+	if(dy < 0) dy = 0;
+
+	return sqrt(dx*dx + dy*dy);
+}
+
+
+void heap_push(neighbour_t *heap, int *count, int k, const neighbour_t *nb){
+	/*
+	adds 'nb' to the max-heap (by distance) of at most k bodies,
+	replacing the farthest one if the heap is full and nb is closer
+	*/
+
+	if(*count == k){
+
+		if(nb->d >= heap[0].d) return;
+
+		heap[0] = *nb;
+		sift_down(heap, 0, *count);
+		return;
+	}
+
+	int i = (*count)++;
+
+	while(i > 0 && heap[(i-1)/2].d < nb->d){
+		heap[i] = heap[(i-1)/2];
+		i = (i-1)/2;
+	}
+
+	heap[i] = *nb;
+}
+
+
+void heap_sort(neighbour_t *heap, int count){
+	/*
+	sorts the max-heap from the closest to the farthest body
+	*/
+
+	for(int end=count-1; end>0; end--){
+
+		neighbour_t temp = heap[0];
+
+		heap[0] = heap[end];
+		heap[end] = temp;
+
+		sift_down(heap, 0, end);
+	}
+}
+
+
+void sift_down(neighbour_t *heap, int i, int count){
+	/*
+	moves down the i-th element of the max-heap of 'count' elements
+	until it is not closer than its children
+	*/
+
+	neighbour_t temp = heap[i];
+
+	while(2*i+1 < count){
+
+		int child = 2*i+1;
+
+		if(child+1 < count && heap[child+1].d > heap[child].d) child++;
+
+		if(heap[child].d <= temp.d) break;
+
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = temp;
+}
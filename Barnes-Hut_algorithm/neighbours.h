@@ -0,0 +1,80 @@
+#ifndef __NEIGHBOURS__H
+#define __NEIGHBOURS__H
+#include <stddef.h>
+#include "barnes_static.h"
+
+
+// body found by a query, with its distance from the query point
+typedef struct neighbour {
+
+  // index of the body ('insert_indexed', 'tree_insert'), -1 if not known
+  long id;
+
+  double x, y;
+  double mass;
+  double d;
+} neighbour_t;
+
+
+	/*
+	finds the bodies of the tree of the context at distance <= r from (x,y),
+	storing the first 'max' of them in 'out' in no particular order; the
+	quadrants farther than r from (x,y) are never entered, so the query costs
+	about O(log N + found)
+
+	returns the number of bodies found, which may be more than 'max'
+	*/
+size_t tree_range (const tree_ctx_t * ctx, double x, double y, double r, neighbour_t * out, size_t max);
+
+
+	/*
+	finds the k bodies of the tree of the context closest to (x,y), storing
+	them in 'out' from the closest; the quadrants are entered from the closest
+	to (x,y) and the ones farther than the k-th body found so far are skipped
+
+	returns the number of bodies found, less than k only if the tree
+	holds less than k bodies
+	*/
+int tree_knn (const tree_ctx_t * ctx, double x, double y, int k, neighbour_t * out);
+
+
+	/*
+	finds for every one of the n bodies the bodies of the tree within distance
+	r from it, the body itself excluded, e.g. the candidates for a collision;
+	bodies[i] is the body of id i of the tree (e.g. built from the same array
+	by 'tree_build'), so only the body itself is left out and not the other
+	ones at the same point;
+	the neighbours of bodies[i] are the ones from offset[i] to offset[i+1] of
+	the returned array, to be freed by the caller ('offset' holds n+1 values)
+
+	the queries are spread over the threads (if compiled with OpenMP)
+
+	returns the array of the neighbours
+	returns NULL if the allocation failed
+	*/
+neighbour_t* tree_range_all (const tree_ctx_t * ctx, const body_t * bodies, size_t n, double r, size_t * offset);
+
+
+	/*
+	finds for every one of the n bodies the k closest bodies of the tree, the
+	body itself (of id i, as for 'tree_range_all') excluded (e.g. for
+	smoothing lengths or local densities),
+	out[i*k],...,out[i*k+k-1] being the ones of bodies[i] from the closest;
+	the missing ones, if the tree holds less than k+1 bodies, have id -1
+	and infinite distance
+
+	the queries are spread over the threads (if compiled with OpenMP)
+
+	returns 0 if the neighbours were found succesfully
+	returns -1 otherwise
+	*/
+int tree_knn_all (const tree_ctx_t * ctx, const body_t * bodies, size_t n, int k, neighbour_t * out);
+
+
+	/*
+	same as 'tree_range' and 'tree_knn' for a tree built by 'insert'
+	(or 'insert_arena', 'insert_indexed') in the universe of radius '_s'
+	*/
+size_t range_search (double x, double y, double r, neighbour_t * out, size_t max, node_t * root);
+int knn_search (double x, double y, int k, neighbour_t * out, node_t * root);
+#endif
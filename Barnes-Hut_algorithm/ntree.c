@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ntree.h"
+#include "pp_kernel.h"
+
+#define NT_RADIX_BITS 11 // bits sorted in each pass of the radix sort
+
+
+// quadtree
+#define NT_DIM 2
+#include "ntree_impl.h"
+#undef NT_DIM
+
+// octree
+#define NT_DIM 3
+#include "ntree_impl.h"
+#undef NT_DIM
@@ -0,0 +1,43 @@
+#ifndef __NTREE__H
+#define __NTREE__H
+#include <stddef.h>
+#include <stdint.h>
+#include "barnes_static.h"
+
+
+// Barnes-Hut tree in 2 (quadtree) and 3 (octree) dimensions
+//
+// the tree is written once in 'ntree_decl.h' (types and functions) and
+// 'ntree_impl.h' (implementation) for a dimension NT_DIM, and the two
+// files are included once for every dimension: the result are two sets
+// of functions, ntree2_* and ntree3_*, each one compiled with its own
+// dimension known at compile time, so every loop over the coordinates
+// is unrolled and the kernels are inlined for that dimension; the leaf
+// kernel is specialised per dimension, the 2 dimensional one being the
+// vectorized 'pp_kernel', and 'linear_tree.h' is the quadtree ntree2
+
+// number of levels resolved by the keys, i.e. bits per coordinate
+// (3*21 bits fit the 64 bits of a key)
+#define NT_LEVELS 21
+
+// default number of bodies in a leaf
+#define NT_LEAF_SIZE 16
+
+// independent components of the quadrupole moment of a node
+#define NT_QUAD (NT_DIM*(NT_DIM+1)/2)
+
+// name of the ntree function or type 'name' for the dimension NT_DIM,
+// e.g. NT_NAME(build) is ntree3_build when NT_DIM is 3
+#define NT_CAT(dim, name) ntree ## dim ## _ ## name
+#define NT_EXPAND(dim, name) NT_CAT(dim, name)
+#define NT_NAME(name) NT_EXPAND(NT_DIM, name)
+
+
+#define NT_DIM 2
+#include "ntree_decl.h"
+#undef NT_DIM
+
+#define NT_DIM 3
+#include "ntree_decl.h"
+#undef NT_DIM
+#endif
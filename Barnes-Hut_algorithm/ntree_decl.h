@@ -0,0 +1,194 @@
+// types and functions of the tree in NT_DIM dimensions,
+// included by 'ntree.h' once for every dimension
+#ifndef NT_DIM
+#error "ntree_decl.h has to be included by ntree.h"
+#endif
+
+
+// body of the N-body problem, the coordinates in x[0],...,x[NT_DIM-1]
+//
+// in 2 dimensions it has the same layout of 'body_t'
+typedef struct {
+  double x[NT_DIM];
+  double mass;
+} NT_NAME(body_t);
+
+// node of the tree
+//
+// nodes are stored breadth first in a flat array, the children of a node
+// are the contiguous range [first, first+nchild) of that array and the
+// bodies below it are the contiguous range [begin, end) of the sorted bodies
+typedef struct {
+
+  // mass center coordinates and total mass
+  double x[NT_DIM];
+  double mass;
+
+  // bodies of the subtree in the sorted arrays
+  uint32_t begin, end;
+
+  // children of the node, nchild = 0 for a leaf
+  uint32_t first;
+  uint8_t nchild;
+
+  // depth in the tree, the node is a cube of radius s/2^level
+  uint8_t level;
+} NT_NAME(node_t);
+
+// tree built from the bodies sorted along the Z-order curve
+typedef struct {
+
+  // bodies sorted along the Z-order curve, one array per coordinate
+  size_t n;
+  double *x[NT_DIM];
+  double *m;
+  uint64_t *keys;
+
+  // 1 if x, m are the arrays of the caller, used in place
+  // (see 'build_sorted'), 0 if they belong to the tree
+  int borrowed;
+
+  // perm[i] is the original index of the i-th sorted body
+  uint32_t *perm;
+
+  // nodes, the root is nodes[0]
+  NT_NAME(node_t) *nodes;
+  size_t n_nodes;
+
+  // quadrupole moments of the i-th node, the NT_QUAD components Q_jk
+  // with j <= k in quad[NT_QUAD*i], NULL unless computed by 'quadrupoles'
+  double *quad;
+
+  // maximum number of bodies in a leaf
+  int leaf_size;
+
+  // radius of the universe, centered in the origin,
+  // and radius of a node for every level
+  double s;
+  double size[NT_LEVELS+1];
+} NT_NAME(t);
+
+
+	/*
+	builds the tree of the n bodies in the universe of radius s centered in
+	the origin (s <= 0 gives the smallest universe holding the bodies), a
+	node is split only if it holds more than 'leaf_size' bodies
+
+	the child of a node holding a point is given by the bits of the
+	coordinates (1 for the upper half of the node), with the conventions
+	of 'get_quadrant' in 2 dimensions, where this is the linear quadtree
+	of 'linear_tree_build'
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+int NT_NAME(build) (NT_NAME(t) * t, const NT_NAME(body_t) * bodies, size_t n, double s, int leaf_size);
+
+
+	/*
+	same as 'build' for the bodies of coordinates x[0][i*stride],...,
+	x[NT_DIM-1][i*stride] and masses m[i*stride], e.g. one array per
+	coordinate (stride 1) or the fields of an array of structures
+	*/
+int NT_NAME(build_strided) (NT_NAME(t) * t, const double * x[NT_DIM], const double * m, size_t stride, size_t n, double s, int leaf_size);
+
+
+	/*
+	same as 'build_strided' with stride 1 for bodies already sorted along
+	the Z-order curve of the universe of radius s (e.g. by 'order'): there
+	is nothing to sort and the tree uses the arrays in place instead of
+	copying them, so they must outlive the tree; s has to be the radius
+	used to sort them
+
+	returns 0 if the tree was built succesfully
+	returns -1 if the bodies are not sorted, s <= 0 or the allocation failed
+	*/
+int NT_NAME(build_sorted) (NT_NAME(t) * t, const double * x[NT_DIM], const double * m, size_t n, double s, int leaf_size);
+
+
+	/*
+	deallocates the tree
+	*/
+void NT_NAME(free) (NT_NAME(t) * t);
+
+
+	/*
+	returns the Z-order key of the point x in a universe of radius s
+	*/
+uint64_t NT_NAME(key) (const double * x, double s);
+
+
+	/*
+	returns the radius of the smallest universe centered in the origin
+	holding the n points of coordinates x[0][i*stride],...,x[NT_DIM-1][i*stride],
+	enlarged a little so no point lies on its border (1 if there are none)
+	*/
+double NT_NAME(fit_radius) (const double * x[NT_DIM], size_t stride, size_t n);
+
+
+	/*
+	sorts the n points of coordinates x[0][i],...,x[NT_DIM-1][i] along the
+	Z-order curve of the universe of radius s, perm[k] being the index of
+	the k-th point of the curve
+
+	returns 0 if the points were sorted succesfully
+	returns -1 otherwise
+	*/
+int NT_NAME(order) (uint32_t * perm, const double * x[NT_DIM], size_t n, double s);
+
+
+	/*
+	quadrupole moments of every node with respect to its mass center,
+	accumulated bottom-up; once computed they are used by the walks for
+	the nodes approximated as a single point
+
+	returns 0 if the moments were calculated succesfully
+	returns -1 otherwise
+	*/
+int NT_NAME(quadrupoles) (NT_NAME(t) * t);
+
+
+	/*
+	adds to f the quadrupole correction to the force on a body of mass m
+	from a node of moments q, D being the vector from the body to the
+	mass center of the node and d its length
+	*/
+void NT_NAME(quadrupole_force) (const double * D, double d, double m, const double * q, double * f);
+
+
+	/*
+	same as 'tree_stats' for the tree, every body of a leaf being counted,
+	the memory being the one of the nodes, the sorted bodies and the moments
+	*/
+void NT_NAME(stats) (const NT_NAME(t) * t, tree_stats_t * stats);
+
+
+	/*
+	returns mass of the body in x
+
+	else returns 0 if the body is not in the tree
+	*/
+double NT_NAME(get_mass) (const double * x, const NT_NAME(t) * t);
+
+
+	/*
+	calculates the force f on the body in x given a tollerance 'theta'
+	*/
+void NT_NAME(get_force) (const double * x, double * f, double theta, const NT_NAME(t) * t);
+
+
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta',
+	f[NT_DIM*i],...,f[NT_DIM*i+NT_DIM-1] is the force on the i-th body in the
+	order used to build the tree
+
+	the walks are spread over the threads (if compiled with OpenMP)
+	*/
+void NT_NAME(get_forces) (double * f, double theta, const NT_NAME(t) * t);
+
+
+	/*
+	same as 'get_forces' with one array per component, f[d][i] being
+	the d-th component of the force on the i-th body
+	*/
+void NT_NAME(get_forces_split) (double * f[NT_DIM], double theta, const NT_NAME(t) * t);
@@ -0,0 +1,936 @@
+// implementation of the tree in NT_DIM dimensions,
+// included by 'ntree.c' once for every dimension
+#ifndef NT_DIM
+#error "ntree_impl.h has to be included by ntree.c"
+#endif
+
+#define NT_CHILDREN (1 << NT_DIM) // children of a node
+#define NT_DIGIT_MASK (NT_CHILDREN - 1)
+#define NT_RADIX_PASSES ((NT_DIM*NT_LEVELS + NT_RADIX_BITS - 1)/NT_RADIX_BITS)
+
+
+static inline uint64_t NT_NAME(spread_bits)(uint32_t v);
+static inline void NT_NAME(leaf_force)(uint32_t i, double *f, const NT_NAME(t) *t, const NT_NAME(node_t) *leaf);
+static inline int NT_NAME(quad_index)(int j, int k);
+void NT_NAME(add_quadrupole)(double *q, double mass, const double *s);
+void NT_NAME(set_universe)(NT_NAME(t) *t, double s, int leaf_size);
+int NT_NAME(radix_sort)(uint64_t *keys, uint32_t *idx, size_t n);
+int NT_NAME(build_nodes)(NT_NAME(t) *t);
+uint32_t NT_NAME(digit_bound)(const uint64_t *keys, uint32_t begin, uint32_t end, int shift, unsigned int d);
+void NT_NAME(accumulate_moments)(NT_NAME(t) *t);
+long long NT_NAME(find_body)(const double *x, const NT_NAME(t) *t);
+void NT_NAME(walk_body)(uint32_t i, double *f, double theta, const NT_NAME(t) *t);
+void NT_NAME(walk_all)(double *f[NT_DIM], size_t stride, double theta, const NT_NAME(t) *t);
+
+
+int NT_NAME(build)(NT_NAME(t) *t, const NT_NAME(body_t) *bodies, size_t n, double s, int leaf_size){
+	/*
+	builds the tree of the n bodies in the universe of radius s, a node
+	is split only if it holds more than 'leaf_size' bodies
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	const double *x[NT_DIM];
+
+	for(int d=0; d<NT_DIM; d++){
+		x[d] = bodies->x + d;
+	}
+
+	return NT_NAME(build_strided)(t, x, &bodies->mass, sizeof(NT_NAME(body_t))/sizeof(double), n, s, leaf_size);
+}
+
+
+int NT_NAME(build_strided)(NT_NAME(t) *t, const double *x[NT_DIM], const double *m, size_t stride, size_t n, double s, int leaf_size){
+	/*
+	builds the tree of the n bodies of coordinates x[d][i*stride]
+	and masses m[i*stride] in the universe of radius s, fitted
+	to the bodies if s <= 0
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	if(s <= 0) s = NT_NAME(fit_radius)(x, stride, n);
+
+	NT_NAME(set_universe)(t, s, leaf_size);
+
+	if(n == 0) return 0;
+	if(n > UINT32_MAX) return -1;
+
+	t->n = n;
+	t->m = malloc(sizeof(double)*n);
+	t->keys = malloc(sizeof(uint64_t)*n);
+	t->perm = malloc(sizeof(uint32_t)*n);
+
+	int failed = (t->m == NULL || t->keys == NULL || t->perm == NULL);
+
+	for(int d=0; d<NT_DIM; d++){
+		t->x[d] = malloc(sizeof(double)*n);
+		if(t->x[d] == NULL) failed = 1;
+	}
+
+	if(failed){
+		NT_NAME(free)(t);
+		return -1;
+	}
+
+	for(size_t i=0; i<n; i++){
+
+		double p[NT_DIM];
+
+		for(int d=0; d<NT_DIM; d++){
+			p[d] = x[d][i*stride];
+		}
+
+		t->keys[i] = NT_NAME(key)(p, s);
+		t->perm[i] = (uint32_t) i;
+	}
+
+	if(NT_NAME(radix_sort)(t->keys, t->perm, n) != 0){
+		NT_NAME(free)(t);
+		return -1;
+	}
+
+	// bodies gathered in Z-order, so every node owns a contiguous slice
+	for(size_t i=0; i<n; i++){
+
+		size_t j = t->perm[i]*stride;
+
+		for(int d=0; d<NT_DIM; d++){
+			t->x[d][i] = x[d][j];
+		}
+		t->m[i] = m[j];
+	}
+
+	if(NT_NAME(build_nodes)(t) != 0){
+		NT_NAME(free)(t);
+		return -1;
+	}
+
+	NT_NAME(accumulate_moments)(t);
+
+	return 0;
+}
+
+
+int NT_NAME(build_sorted)(NT_NAME(t) *t, const double *x[NT_DIM], const double *m, size_t n, double s, int leaf_size){
+	/*
+	builds the tree of the n bodies already sorted along the Z-order
+	curve of the universe of radius s, using the arrays x, m in place
+
+	returns 0 if the tree was built succesfully
+	returns -1 if the bodies are not sorted or the allocation failed
+	*/
+
+	NT_NAME(set_universe)(t, s, leaf_size);
+
+	if(n == 0) return 0;
+
+	// the order of the bodies only holds in the universe it was made for
+	if(s <= 0) return -1;
+	if(n > UINT32_MAX) return -1;
+
+	t->n = n;
+	t->keys = malloc(sizeof(uint64_t)*n);
+	t->perm = malloc(sizeof(uint32_t)*n);
+
+	// the tree never writes the bodies
+	for(int d=0; d<NT_DIM; d++){
+		t->x[d] = (double *) x[d];
+	}
+	t->m = (double *) m;
+	t->borrowed = 1;
+
+	if(t->keys == NULL || t->perm == NULL){
+		NT_NAME(free)(t);
+		return -1;
+	}
+
+	for(size_t i=0; i<n; i++){
+
+		double p[NT_DIM];
+
+		for(int d=0; d<NT_DIM; d++){
+			p[d] = x[d][i];
+		}
+
+		t->keys[i] = NT_NAME(key)(p, s);
+		t->perm[i] = (uint32_t) i;
+
+		if(i > 0 && t->keys[i] < t->keys[i-1]){
+			NT_NAME(free)(t);
+			return -1;
+		}
+	}
+
+	if(NT_NAME(build_nodes)(t) != 0){
+		NT_NAME(free)(t);
+		return -1;
+	}
+
+	NT_NAME(accumulate_moments)(t);
+
+	return 0;
+}
+
+
+void NT_NAME(free)(NT_NAME(t) *t){
+	/*
+	deallocates the tree
+	*/
+
+	for(int d=0; d<NT_DIM; d++){
+		if(!t->borrowed) free(t->x[d]);
+		t->x[d] = NULL;
+	}
+
+	if(!t->borrowed) free(t->m);
+	free(t->keys);
+	free(t->perm);
+	free(t->nodes);
+	free(t->quad);
+
+	t->m = NULL;
+	t->keys = NULL;
+	t->perm = NULL;
+	t->nodes = NULL;
+	t->quad = NULL;
+	t->n = 0;
+	t->n_nodes = 0;
+	t->borrowed = 0;
+}
+
+
+uint64_t NT_NAME(key)(const double *x, double s){
+	/*
+	returns the Z-order key of the point x in a universe of radius s
+
+	the NT_DIM bits of level h (from the most significant) tell
+	if the point is in the upper half of the node along each axis,
+	the first coordinate giving the most significant bit; a point on
+	the border of a node goes to the lower half along the first axis
+	and to the upper half along the others, as in 'get_quadrant'
+	*/
+
+	double cells = ldexp(1.0, NT_LEVELS);
+	uint64_t key = 0;
+
+	for(int d=0; d<NT_DIM; d++){
+
+		double u = (x[d] + s)/(2*s)*cells;
+		double c = (d == 0) ? ceil(u) - 1 : floor(u);
+
+		// points outside the universe end up in the border cells
+		if(c < 0) c = 0;
+		if(c > cells-1) c = cells-1;
+
+		key |= NT_NAME(spread_bits)((uint32_t) c) << (NT_DIM - 1 - d);
+	}
+
+	return key;
+}
+
+
+int NT_NAME(order)(uint32_t *perm, const double *x[NT_DIM], size_t n, double s){
+	/*
+	sorts the n points x[.][i] along the Z-order curve
+	of the universe of radius s
+
+	returns 0 if the points were sorted succesfully
+	returns -1 otherwise
+	*/
+
+	if(n > UINT32_MAX) return -1;
+	if(n == 0) return 0;
+
+	uint64_t *keys = malloc(sizeof(uint64_t)*n);
+
+	if(keys == NULL) return -1;
+
+	for(size_t i=0; i<n; i++){
+
+		double p[NT_DIM];
+
+		for(int d=0; d<NT_DIM; d++){
+			p[d] = x[d][i];
+		}
+
+		keys[i] = NT_NAME(key)(p, s);
+		perm[i] = (uint32_t) i;
+	}
+
+	int retval = NT_NAME(radix_sort)(keys, perm, n);
+
+	free(keys);
+
+	return retval;
+}
+
+
+double NT_NAME(fit_radius)(const double *x[NT_DIM], size_t stride, size_t n){
+	/*
+	returns the radius of the smallest universe centered in the origin
+	holding the n bodies, enlarged a little so no body lies on its border
+	*/
+
+	double s = 0;
+
+	for(size_t i=0; i<n; i++){
+		for(int d=0; d<NT_DIM; d++){
+			if(fabs(x[d][i*stride]) > s) s = fabs(x[d][i*stride]);
+		}
+	}
+
+	// no bodies, or all of them in the origin
+	if(s == 0) return 1;
+
+	return 1.001*s;
+}
+
+
+double NT_NAME(get_mass)(const double *x, const NT_NAME(t) *t){
+	/*
+	returns mass of the body in x
+
+	else returns 0 if the body is not in the tree
+	*/
+
+	long long i = NT_NAME(find_body)(x, t);
+
+	if(i < 0) return 0;
+
+	return t->m[i];
+}
+
+
+void NT_NAME(get_force)(const double *x, double *f, double theta, const NT_NAME(t) *t){
+	/*
+	calculates the force f on the body in x given a tollerance 'theta'
+	*/
+
+	for(int d=0; d<NT_DIM; d++){
+		f[d] = 0;
+	}
+
+	long long i = NT_NAME(find_body)(x, t);
+
+	if(i < 0 || t->m[i] == 0) return;
+
+	NT_NAME(walk_body)((uint32_t) i, f, theta, t);
+	WALK_FLUSH();
+}
+
+
+void NT_NAME(get_forces)(double *f, double theta, const NT_NAME(t) *t){
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta'
+	*/
+
+	double *fd[NT_DIM];
+
+	for(int d=0; d<NT_DIM; d++){
+		fd[d] = f + d;
+	}
+
+	NT_NAME(walk_all)(fd, NT_DIM, theta, t);
+}
+
+
+void NT_NAME(get_forces_split)(double *f[NT_DIM], double theta, const NT_NAME(t) *t){
+	/*
+	calculates the force on every body of the tree given a tollerance 'theta',
+	one array per component
+	*/
+
+	NT_NAME(walk_all)(f, 1, theta, t);
+}
+
+
+int NT_NAME(quadrupoles)(NT_NAME(t) *t){
+	/*
+	quadrupole moments of every node with respect to its mass center,
+	accumulated bottom-up; once computed they are used by the walks for
+	the nodes approximated as a single point
+
+	returns 0 if the moments were calculated succesfully
+	returns -1 otherwise
+	*/
+
+	if(t->n_nodes == 0) return 0;
+
+	free(t->quad);
+	t->quad = calloc(NT_QUAD*t->n_nodes, sizeof(double));
+	if(t->quad == NULL) return -1;
+
+	for(size_t i=t->n_nodes; i-- > 0;){
+
+		const NT_NAME(node_t) *node = t->nodes + i;
+		double *q = t->quad + NT_QUAD*i;
+		double sep[NT_DIM];
+
+		if(node->nchild == 0){
+			for(uint32_t j=node->begin; j<node->end; j++){
+				for(int d=0; d<NT_DIM; d++){
+					sep[d] = t->x[d][j] - node->x[d];
+				}
+				NT_NAME(add_quadrupole)(q, t->m[j], sep);
+			}
+			continue;
+		}
+
+		// moments of the children moved to the mass center of the node
+		// (parallel axis theorem)
+		for(int c=0; c<node->nchild; c++){
+
+			size_t k = node->first + c;
+			const NT_NAME(node_t) *child = t->nodes + k;
+
+			for(int j=0; j<NT_QUAD; j++){
+				q[j] += t->quad[NT_QUAD*k + j];
+			}
+
+			for(int d=0; d<NT_DIM; d++){
+				sep[d] = child->x[d] - node->x[d];
+			}
+			NT_NAME(add_quadrupole)(q, child->mass, sep);
+		}
+	}
+
+	return 0;
+}
+
+
+void NT_NAME(quadrupole_force)(const double *D, double d, double m, const double *q, double *f){
+	/*
+	adds to f the quadrupole correction to the force on a body of mass m
+	from a node of moments q, D being the vector from the body to the mass
+	center of the node and d its length
+
+	F = G*m*( -Q.D/d^5 + 5/2 (D.Q.D) D/d^7 )
+	*/
+
+	double QD[NT_DIM] = {0};
+	double DQD = 0;
+
+	for(int j=0; j<NT_DIM; j++){
+		for(int k=0; k<NT_DIM; k++){
+			QD[j] += q[NT_NAME(quad_index)(j, k)]*D[k];
+		}
+		DQD += D[j]*QD[j];
+	}
+
+	double d2 = d*d;
+	double inv5 = 1/(d2*d2*d);
+	double c = 2.5*DQD/d2;
+
+	for(int j=0; j<NT_DIM; j++){
+		f[j] += G*m*inv5*(c*D[j] - QD[j]);
+	}
+}
+
+
+void NT_NAME(stats)(const NT_NAME(t) *t, tree_stats_t *stats){
+	/*
+	shape and memory of the tree
+	*/
+
+	memset(stats, 0, sizeof(tree_stats_t));
+
+	for(size_t i=0; i<t->n_nodes; i++){
+
+		const NT_NAME(node_t) *node = t->nodes + i;
+
+		stats->nodes++;
+		stats->depth[(node->level < TREE_LEVELS) ? node->level : TREE_LEVELS-1]++;
+		if(node->level > stats->max_depth) stats->max_depth = node->level;
+
+		if(node->nchild > 0) continue;
+
+		if(node->mass == 0) stats->empty++;
+			else stats->leaves++;
+
+		stats->bodies += node->end - node->begin;
+	}
+
+	stats->bytes = t->n_nodes*sizeof(NT_NAME(node_t)) + t->n*(sizeof(uint64_t) + sizeof(uint32_t));
+	if(!t->borrowed) stats->bytes += (NT_DIM+1)*t->n*sizeof(double);
+	if(t->quad != NULL) stats->bytes += NT_QUAD*t->n_nodes*sizeof(double);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+static inline uint64_t NT_NAME(spread_bits)(uint32_t v){
+	/*
+	moves the i-th bit of v to the bit NT_DIM*i of the result,
+	leaving the other bits at 0
+	*/
+
+	uint64_t x = v & 0x1FFFFF;
+
+#if NT_DIM == 2
+	x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+	x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+	x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+	x = (x | (x << 2))  & 0x3333333333333333ULL;
+	x = (x | (x << 1))  & 0x5555555555555555ULL;
+#elif NT_DIM == 3
+	x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+	x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+	x = (x | (x << 8))  & 0x100F00F00F00F00FULL;
+	x = (x | (x << 4))  & 0x10C30C30C30C30C3ULL;
+	x = (x | (x << 2))  & 0x1249249249249249ULL;
+#else
+#error "ntree is implemented for 2 and 3 dimensions"
+#endif
+
+	return x;
+}
+
+
+static inline void NT_NAME(leaf_force)(uint32_t i, double *f, const NT_NAME(t) *t, const NT_NAME(node_t) *leaf){
+	/*
+	direct sum of the forces of the bodies in a leaf on the i-th sorted body,
+	the body itself is at zero distance and is skipped
+	*/
+
+	double a[NT_DIM] = {0};
+
+#if NT_DIM == 2
+	// the bodies of the leaf are contiguous in the sorted arrays,
+	// so they go straight to the vectorized kernel
+	pp_kernel(t->x[0][i], t->x[1][i], t->x[0] + leaf->begin, t->x[1] + leaf->begin, t->m + leaf->begin, leaf->end - leaf->begin, a, a+1);
+#else
+	double p[NT_DIM];
+
+	for(int d=0; d<NT_DIM; d++){
+		p[d] = t->x[d][i];
+	}
+
+	for(uint32_t j=leaf->begin; j<leaf->end; j++){
+
+		double dx[NT_DIM];
+		double d2 = 0;
+
+		for(int d=0; d<NT_DIM; d++){
+			dx[d] = t->x[d][j] - p[d];
+			d2 += dx[d]*dx[d];
+		}
+
+		double inv = (d2 > 0) ? 1/sqrt(d2) : 0;
+		double w = t->m[j]*inv*inv*inv;
+
+		for(int d=0; d<NT_DIM; d++){
+			a[d] += w*dx[d];
+		}
+	}
+#endif
+
+	for(int d=0; d<NT_DIM; d++){
+		f[d] += G*t->m[i]*a[d];
+	}
+}
+
+
+static inline int NT_NAME(quad_index)(int j, int k){
+	/*
+	returns the position of Q_jk among the moments of a node,
+	which are stored row by row for j <= k
+	*/
+
+	if(j > k){
+		int tmp = j; j = k; k = tmp;
+	}
+
+	return j*NT_DIM - j*(j-1)/2 + (k-j);
+}
+
+
+void NT_NAME(add_quadrupole)(double *q, double mass, const double *s){
+	/*
+	adds to q the quadrupole of a point of mass 'mass' displaced by s
+	from the center, Q_jk = m*(3 s_j s_k - |s|^2 delta_jk)
+	*/
+
+	double s2 = 0;
+
+	for(int d=0; d<NT_DIM; d++){
+		s2 += s[d]*s[d];
+	}
+
+	int c = 0;
+
+	for(int j=0; j<NT_DIM; j++){
+		q[c++] += mass*(3*s[j]*s[j] - s2);
+		for(int k=j+1; k<NT_DIM; k++){
+			q[c++] += mass*3*s[j]*s[k];
+		}
+	}
+}
+
+
+void NT_NAME(set_universe)(NT_NAME(t) *t, double s, int leaf_size){
+	/*
+	initializes the empty tree 't' in the universe of radius s
+	*/
+
+	memset(t, 0, sizeof(NT_NAME(t)));
+
+	t->s = s;
+	t->leaf_size = (leaf_size < 1) ? 1 : leaf_size;
+	for(int h=0; h<=NT_LEVELS; h++){
+		t->size[h] = ldexp(s, -h);
+	}
+}
+
+
+int NT_NAME(radix_sort)(uint64_t *keys, uint32_t *idx, size_t n){
+	/*
+	least significant digit radix sort of the keys, the indices 'idx'
+	are moved along with them
+
+	returns 0 if the sort happened succesfully
+	returns -1 otherwise
+	*/
+
+	uint64_t *keys_tmp = malloc(sizeof(uint64_t)*n);
+	uint32_t *idx_tmp = malloc(sizeof(uint32_t)*n);
+	size_t *count = malloc(sizeof(size_t)*(1 << NT_RADIX_BITS));
+
+	if(keys_tmp == NULL || idx_tmp == NULL || count == NULL){
+		free(keys_tmp);
+		free(idx_tmp);
+		free(count);
+		return -1;
+	}
+
+	uint64_t *src_k = keys, *dst_k = keys_tmp;
+	uint32_t *src_i = idx, *dst_i = idx_tmp;
+	uint64_t mask = (1 << NT_RADIX_BITS) - 1;
+
+	for(int pass=0; pass<NT_RADIX_PASSES; pass++){
+
+		int shift = pass*NT_RADIX_BITS;
+
+		memset(count, 0, sizeof(size_t)*(1 << NT_RADIX_BITS));
+
+		for(size_t i=0; i<n; i++){
+			count[(src_k[i] >> shift) & mask]++;
+		}
+
+		// every key has the same digit, nothing to move
+		if(count[(src_k[0] >> shift) & mask] == n) continue;
+
+		size_t sum = 0;
+		for(size_t d=0; d<((size_t) 1 << NT_RADIX_BITS); d++){
+			size_t c = count[d];
+			count[d] = sum;
+			sum += c;
+		}
+
+		for(size_t i=0; i<n; i++){
+			size_t pos = count[(src_k[i] >> shift) & mask]++;
+			dst_k[pos] = src_k[i];
+			dst_i[pos] = src_i[i];
+		}
+
+		uint64_t *swap_k = src_k; src_k = dst_k; dst_k = swap_k;
+		uint32_t *swap_i = src_i; src_i = dst_i; dst_i = swap_i;
+	}
+
+	if(src_k != keys){
+		memcpy(keys, src_k, sizeof(uint64_t)*n);
+		memcpy(idx, src_i, sizeof(uint32_t)*n);
+	}
+
+	free(keys_tmp);
+	free(idx_tmp);
+	free(count);
+
+	return 0;
+}
+
+
+int NT_NAME(build_nodes)(NT_NAME(t) *t){
+	/*
+	builds the nodes breadth first on the sorted keys: a node holding more
+	than 'leaf_size' bodies is split in the non empty children given by the
+	next digit of the keys, so the children of every node are appended
+	next to each other
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	size_t cap = 2*t->n;
+
+	t->nodes = malloc(sizeof(NT_NAME(node_t))*cap);
+	if(t->nodes == NULL) return -1;
+
+	memset(t->nodes, 0, sizeof(NT_NAME(node_t)));
+	t->nodes[0].begin = 0;
+	t->nodes[0].end = (uint32_t) t->n;
+	t->n_nodes = 1;
+
+	for(size_t i=0; i<t->n_nodes; i++){
+
+		uint32_t begin = t->nodes[i].begin;
+		uint32_t end = t->nodes[i].end;
+		int level = t->nodes[i].level;
+
+		// leaf: few enough bodies or bodies that can not be separated anymore
+		if(end - begin <= (uint32_t) t->leaf_size || level == NT_LEVELS) continue;
+
+		if(t->n_nodes + NT_CHILDREN > cap){
+			cap *= 2;
+			NT_NAME(node_t) *temp = realloc(t->nodes, sizeof(NT_NAME(node_t))*cap);
+			if(temp == NULL) return -1;
+			t->nodes = temp;
+		}
+
+		int shift = NT_DIM*(NT_LEVELS - level - 1);
+
+		t->nodes[i].first = (uint32_t) t->n_nodes;
+		t->nodes[i].nchild = 0;
+
+		// the bodies of a node are sorted by digit, so each
+		// non empty child is a contiguous slice
+		for(unsigned int d=0; d<NT_CHILDREN && begin<end; d++){
+
+			uint32_t bound = NT_NAME(digit_bound)(t->keys, begin, end, shift, d);
+			if(bound == begin) continue;
+
+			NT_NAME(node_t) *child = t->nodes + t->n_nodes++;
+			memset(child, 0, sizeof(NT_NAME(node_t)));
+			child->begin = begin;
+			child->end = bound;
+			child->level = (uint8_t) (level + 1);
+
+			t->nodes[i].nchild++;
+			begin = bound;
+		}
+	}
+
+	return 0;
+}
+
+
+uint32_t NT_NAME(digit_bound)(const uint64_t *keys, uint32_t begin, uint32_t end, int shift, unsigned int d){
+	/*
+	returns the first position in [begin,end) whose digit
+	at 'shift' is larger than d (binary search)
+	*/
+
+	while(begin < end){
+		uint32_t mid = begin + (end - begin)/2;
+
+		if(((keys[mid] >> shift) & NT_DIGIT_MASK) <= d) begin = mid + 1;
+			else end = mid;
+	}
+
+	return begin;
+}
+
+
+void NT_NAME(accumulate_moments)(NT_NAME(t) *t){
+	/*
+	total mass and mass center of every node, visiting the nodes
+	backwards so the children are always done before their parent
+	*/
+
+	for(size_t i=t->n_nodes; i-- > 0;){
+
+		NT_NAME(node_t) *node = t->nodes + i;
+		double mass = 0;
+		double mx[NT_DIM] = {0};
+
+		// a single body keeps exactly its own coordinates
+		if(node->nchild == 0 && node->end - node->begin == 1){
+			for(int d=0; d<NT_DIM; d++){
+				node->x[d] = t->x[d][node->begin];
+			}
+			node->mass = t->m[node->begin];
+			continue;
+		}
+
+		if(node->nchild == 0){
+			for(uint32_t j=node->begin; j<node->end; j++){
+				mass += t->m[j];
+				for(int d=0; d<NT_DIM; d++){
+					mx[d] += t->m[j]*t->x[d][j];
+				}
+			}
+		}
+
+		else{
+			for(int c=0; c<node->nchild; c++){
+				const NT_NAME(node_t) *child = t->nodes + node->first + c;
+				mass += child->mass;
+				for(int d=0; d<NT_DIM; d++){
+					mx[d] += child->mass*child->x[d];
+				}
+			}
+		}
+
+		node->mass = mass;
+		for(int d=0; d<NT_DIM; d++){
+			node->x[d] = (mass > 0) ? mx[d]/mass : 0;
+		}
+	}
+}
+
+
+long long NT_NAME(find_body)(const double *x, const NT_NAME(t) *t){
+	/*
+	returns the position in the sorted arrays of the body in x
+
+	else returns -1 if the body is not in the tree
+	*/
+
+	if(t->n_nodes == 0) return -1;
+
+	uint64_t key = NT_NAME(key)(x, t->s);
+	const NT_NAME(node_t) *node = t->nodes;
+
+	// descent following the digits of the key
+	while(node->nchild > 0){
+
+		int shift = NT_DIM*(NT_LEVELS - node->level - 1);
+		unsigned int d = (unsigned int) (key >> shift) & NT_DIGIT_MASK;
+		const NT_NAME(node_t) *next = NULL;
+
+		for(int c=0; c<node->nchild; c++){
+			const NT_NAME(node_t) *child = t->nodes + node->first + c;
+
+			if(((t->keys[child->begin] >> shift) & NT_DIGIT_MASK) == d){
+				next = child;
+				break;
+			}
+		}
+
+		if(next == NULL) return -1;
+		node = next;
+	}
+
+	for(uint32_t i=node->begin; i<node->end; i++){
+
+		int same = 1;
+
+		for(int d=0; d<NT_DIM; d++){
+			if(t->x[d][i] != x[d]) same = 0;
+		}
+
+		if(same) return i;
+	}
+
+	return -1;
+}
+
+
+void NT_NAME(walk_body)(uint32_t i, double *f, double theta, const NT_NAME(t) *t){
+	/*
+	adds to f the force on the i-th sorted body following the
+	barnes-hut approximation depending on the tollerance 'theta'
+	*/
+
+	double p[NT_DIM];
+	double m = t->m[i];
+
+	for(int d=0; d<NT_DIM; d++){
+		p[d] = t->x[d][i];
+	}
+
+	// depth first walk with an explicit stack, every level leaves
+	// at most NT_CHILDREN-1 siblings waiting on it
+	uint32_t stack[NT_CHILDREN*(NT_LEVELS+2)];
+	int top = 0;
+
+	stack[top++] = 0;
+	WALK_COUNT(walks, 1);
+
+	while(top > 0){
+
+		const NT_NAME(node_t) *node = t->nodes + stack[--top];
+
+		WALK_COUNT(visited, 1);
+
+		// empty node
+		if(node->mass == 0) continue;
+
+		double D[NT_DIM];
+		double d2 = 0;
+
+		for(int d=0; d<NT_DIM; d++){
+			D[d] = node->x[d] - p[d];
+			d2 += D[d]*D[d];
+		}
+
+		double dist = sqrt(d2);
+
+		// the node's mass center is far enough from the body
+		// to be considered a single point, a node holding the
+		// body itself is always opened
+		int inside = (i >= node->begin && i < node->end);
+
+		if(!inside && t->size[node->level]/dist < theta){
+
+			WALK_COUNT(accepted, 1);
+
+			double w = G*m*(node->mass)/(d2*dist);
+
+			for(int d=0; d<NT_DIM; d++){
+				f[d] += w*D[d];
+			}
+
+			if(t->quad != NULL) NT_NAME(quadrupole_force)(D, dist, m, t->quad + NT_QUAD*(size_t) (node - t->nodes), f);
+
+			continue;
+		}
+
+		// leaf opened, direct sum over its bodies
+		if(node->nchild == 0){
+			WALK_COUNT(leaf, node->end - node->begin - inside);
+			NT_NAME(leaf_force)(i, f, t, node);
+			continue;
+		}
+
+		// pushed in reverse so the children are visited in memory order
+		for(int c=node->nchild-1; c>=0; c--){
+			stack[top++] = node->first + c;
+		}
+	}
+}
+
+
+void NT_NAME(walk_all)(double *f[NT_DIM], size_t stride, double theta, const NT_NAME(t) *t){
+	/*
+	walks the tree for every body, the d-th component of the force on
+	the i-th body (in the order used to build the tree) going to f[d][stride*i]
+	*/
+
+	// the bodies are taken in Z-order, so the bodies of a chunk are neighbours
+	// and walk almost the same nodes; bodies in dense regions cost more,
+	// the chunks are handed out dynamically to balance the threads
+	#pragma omp parallel
+	{
+		#pragma omp for schedule(dynamic, 64)
+		for(size_t i=0; i<t->n; i++){
+
+			double fi[NT_DIM] = {0};
+
+			if(t->m[i] != 0) NT_NAME(walk_body)((uint32_t) i, fi, theta, t);
+
+			for(int d=0; d<NT_DIM; d++){
+				f[d][stride*t->perm[i]] = fi[d];
+			}
+		}
+
+		WALK_FLUSH();
+	}
+}
+
+
+#undef NT_CHILDREN
+#undef NT_DIGIT_MASK
+#undef NT_RADIX_PASSES
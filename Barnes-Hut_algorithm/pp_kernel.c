@@ -0,0 +1,239 @@
+#include <math.h>
+#include "pp_kernel.h"
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__)) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+
+void pp_kernel_scalar(double x, double y, const double *xs, const double *ys, const double *ms, size_t count, double *ax, double *ay);
+void pp_kernel_float_scalar(const float *dx, const float *dy, const float *ms, size_t count, double *ax, double *ay);
+
+
+#if defined(__AVX512F__)
+void pp_kernel(double x, double y, const double *xs, const double *ys, const double *ms, size_t count, double *ax, double *ay){
+	/*
+	AVX-512 version, 8 bodies at a time and a masked tail
+	*/
+
+	__m512d px = _mm512_set1_pd(x);
+	__m512d py = _mm512_set1_pd(y);
+	__m512d one = _mm512_set1_pd(1.0);
+	__m512d zero = _mm512_setzero_pd();
+	__m512d sx = zero;
+	__m512d sy = zero;
+
+	for(size_t j=0; j<count; j+=8){
+
+		// lanes past the end of the leaf are loaded as 0 and left out
+		__mmask8 tail = (count - j >= 8) ? 0xFF : (__mmask8) ((1u << (count - j)) - 1);
+
+		__m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, xs + j), px);
+		__m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(tail, ys + j), py);
+		__m512d m = _mm512_maskz_loadu_pd(tail, ms + j);
+		__m512d d2 = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+
+		__mmask8 valid = tail & _mm512_cmp_pd_mask(d2, zero, _CMP_GT_OQ);
+
+		__m512d inv = _mm512_maskz_div_pd(valid, one, _mm512_sqrt_pd(d2));
+		__m512d w = _mm512_mul_pd(m, _mm512_mul_pd(inv, _mm512_mul_pd(inv, inv)));
+
+		sx = _mm512_fmadd_pd(w, dx, sx);
+		sy = _mm512_fmadd_pd(w, dy, sy);
+	}
+
+	*ax += _mm512_reduce_add_pd(sx);
+	*ay += _mm512_reduce_add_pd(sy);
+}
+
+
+#elif defined(__AVX2__) && defined(__FMA__)
+void pp_kernel(double x, double y, const double *xs, const double *ys, const double *ms, size_t count, double *ax, double *ay){
+	/*
+	AVX2 version, 4 bodies at a time and the tail done by the scalar loop
+	*/
+
+	__m256d px = _mm256_set1_pd(x);
+	__m256d py = _mm256_set1_pd(y);
+	__m256d one = _mm256_set1_pd(1.0);
+	__m256d zero = _mm256_setzero_pd();
+	__m256d sx = zero;
+	__m256d sy = zero;
+	size_t j = 0;
+
+	for(; j+4<=count; j+=4){
+
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + j), px);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + j), py);
+		__m256d m = _mm256_loadu_pd(ms + j);
+		__m256d d2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+
+		// lanes at zero distance give inf or nan, they are zeroed by the mask
+		__m256d valid = _mm256_cmp_pd(d2, zero, _CMP_GT_OQ);
+
+		__m256d inv = _mm256_div_pd(one, _mm256_sqrt_pd(d2));
+		__m256d w = _mm256_mul_pd(m, _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv)));
+		w = _mm256_and_pd(w, valid);
+
+		sx = _mm256_fmadd_pd(w, dx, sx);
+		sy = _mm256_fmadd_pd(w, dy, sy);
+	}
+
+	double lanes_x[4], lanes_y[4];
+	_mm256_storeu_pd(lanes_x, sx);
+	_mm256_storeu_pd(lanes_y, sy);
+
+	*ax += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+	*ay += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+
+	pp_kernel_scalar(x, y, xs + j, ys + j, ms + j, count - j, ax, ay);
+}
+
+
+#else
+void pp_kernel(double x, double y, const double *xs, const double *ys, const double *ms, size_t count, double *ax, double *ay){
+	/*
+	no vector extension available
+	*/
+
+	pp_kernel_scalar(x, y, xs, ys, ms, count, ax, ay);
+}
+#endif
+
+
+void pp_kernel_scalar(double x, double y, const double *xs, const double *ys, const double *ms, size_t count, double *ax, double *ay){
+	/*
+	plain version of the kernel, written without branches in
+	the loop body so the compiler is free to vectorize it
+	*/
+
+	double sx = 0;
+	double sy = 0;
+
+	for(size_t j=0; j<count; j++){
+
+		double dx = xs[j] - x;
+		double dy = ys[j] - y;
+		double d2 = dx*dx + dy*dy;
+		double inv = (d2 > 0) ? 1/sqrt(d2) : 0;
+		double w = ms[j]*inv*inv*inv;
+
+		sx += w*dx;
+		sy += w*dy;
+	}
+
+	*ax += sx;
+	*ay += sy;
+}
+
+
+#if defined(__AVX__)
+void pp_kernel_float(const float *dx, const float *dy, const float *ms, size_t count, double *ax, double *ay){
+	/*
+	AVX version, 8 points at a time and the tail done by the scalar loop
+	*/
+
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256 three_halves = _mm256_set1_ps(1.5f);
+	__m256 sx = _mm256_setzero_ps();
+	__m256 sy = _mm256_setzero_ps();
+	size_t j = 0;
+
+	for(; j+8<=count; j+=8){
+
+		__m256 x = _mm256_loadu_ps(dx + j);
+		__m256 y = _mm256_loadu_ps(dy + j);
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+
+		// 1/sqrt(d2) to 12 bits, then a step of Newton's method
+		__m256 inv = _mm256_rsqrt_ps(d2);
+		inv = _mm256_mul_ps(inv, _mm256_sub_ps(three_halves, _mm256_mul_ps(_mm256_mul_ps(half, d2), _mm256_mul_ps(inv, inv))));
+
+		__m256 w = _mm256_mul_ps(_mm256_loadu_ps(ms + j), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(w, x));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(w, y));
+	}
+
+	float lanes_x[8], lanes_y[8];
+	_mm256_storeu_ps(lanes_x, sx);
+	_mm256_storeu_ps(lanes_y, sy);
+
+	for(int l=0; l<8; l++){
+		*ax += lanes_x[l];
+		*ay += lanes_y[l];
+	}
+
+	pp_kernel_float_scalar(dx + j, dy + j, ms + j, count - j, ax, ay);
+}
+
+
+#elif defined(__SSE__)
+void pp_kernel_float(const float *dx, const float *dy, const float *ms, size_t count, double *ax, double *ay){
+	/*
+	SSE version, 4 points at a time and the tail done by the scalar loop
+	*/
+
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 three_halves = _mm_set1_ps(1.5f);
+	__m128 sx = _mm_setzero_ps();
+	__m128 sy = _mm_setzero_ps();
+	size_t j = 0;
+
+	for(; j+4<=count; j+=4){
+
+		__m128 x = _mm_loadu_ps(dx + j);
+		__m128 y = _mm_loadu_ps(dy + j);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+
+		__m128 inv = _mm_rsqrt_ps(d2);
+		inv = _mm_mul_ps(inv, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half, d2), _mm_mul_ps(inv, inv))));
+
+		__m128 w = _mm_mul_ps(_mm_loadu_ps(ms + j), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+
+		sx = _mm_add_ps(sx, _mm_mul_ps(w, x));
+		sy = _mm_add_ps(sy, _mm_mul_ps(w, y));
+	}
+
+	float lanes_x[4], lanes_y[4];
+	_mm_storeu_ps(lanes_x, sx);
+	_mm_storeu_ps(lanes_y, sy);
+
+	for(int l=0; l<4; l++){
+		*ax += lanes_x[l];
+		*ay += lanes_y[l];
+	}
+
+	pp_kernel_float_scalar(dx + j, dy + j, ms + j, count - j, ax, ay);
+}
+
+
+#else
+void pp_kernel_float(const float *dx, const float *dy, const float *ms, size_t count, double *ax, double *ay){
+	/*
+	no vector extension available
+	*/
+
+	pp_kernel_float_scalar(dx, dy, ms, count, ax, ay);
+}
+#endif
+
+
+void pp_kernel_float_scalar(const float *dx, const float *dy, const float *ms, size_t count, double *ax, double *ay){
+	/*
+	plain version of the single precision kernel, each
+	point being added to the double precision sums
+	*/
+
+	for(size_t j=0; j<count; j++){
+
+		float d2 = dx[j]*dx[j] + dy[j]*dy[j];
+		float inv = 1.0f/sqrtf(d2);
+		float w = ms[j]*inv*inv*inv;
+
+		*ax += (double) (w*dx[j]);
+		*ay += (double) (w*dy[j]);
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef __PP_KERNEL__H
+#define __PP_KERNEL__H
+#include <stddef.h>
+
+
+	/*
+	direct sum (particle-particle) of the interactions of the 'count' bodies
+	of coordinates (xs[j],ys[j]) and masses ms[j] with the point (x,y)
+
+	adds to (ax,ay) the sum of ms[j]*(r_j - r)/|r_j - r|^3, i.e. the
+	force on a body in (x,y) up to the factor G*m; bodies sitting exactly
+	in (x,y), the body itself included, are skipped
+
+	the kernel uses AVX-512 or AVX2 when the file is compiled for them
+	(e.g. with -march=native) and a plain loop otherwise
+	*/
+void pp_kernel (double x, double y, const double * xs, const double * ys, const double * ms, size_t count, double * ax, double * ay);
+
+
+	/*
+	same as 'pp_kernel' in single precision for the 'count' points at
+	(dx[j],dy[j]) from the body, none of them at zero distance: adds to
+	(ax,ay) the sum of ms[j]*(dx[j],dy[j])/|d_j|^3, with 1/|d_j| taken from
+	the approximated reciprocal square root of the processor refined by a
+	step of Newton's method (about 23 bits)
+
+	the squares and cubes are taken in single precision, so the offsets
+	should be scaled to order 1 (e.g. in units of the radius of the
+	universe) and the sums rescaled by the caller, or they overflow
+	above about 1e19 and lose every digit below about 1e-13
+
+	the kernel uses AVX or SSE when the file is compiled for them
+	and a plain loop otherwise
+	*/
+void pp_kernel_float (const float * dx, const float * dy, const float * ms, size_t count, double * ax, double * ay);
+#endif
@@ -12,19 +12,29 @@ void print_tree (FILE * f, int mode, node_t * q){
    print_tree_aux(f,mode,0," ", q); 
 }
 
+void print_stats (FILE * f, const tree_stats_t * st){
+  int i;
+  if ( f == NULL || st == NULL ) return ;
+  fprintf(f,"nodes %zu leaves %zu empty %zu bodies %zu bytes %zu max depth %d\n",
+          st->nodes, st->leaves, st->empty, st->bodies, st->bytes, st->max_depth);
+  for (i=0; i<TREE_LEVELS && i<=st->max_depth; i++) {
+    fprintf(f,"  depth %2d: %zu\n", i, st->depth[i]);
+  }
+}
+
 static void print_tree_aux(FILE * f, int mode, int l, char* s , node_t * q){
   int i;
   if ( q == NULL ) return;
-  for (i=0; i>l; i++) {
-    putchar(' ');
+  for (i=0; i<l; i++) {
+    fputc(' ', f);
   }
-  putchar('[');
+  fputc('[', f);
   if ( mode == 0 )
     fprintf(f," liv %d %s:(%.2f,%.2f) m: %.2f ", l, s, q->x,q->y,q->mass);
   else
     fprintf(f," liv %d %s:(%.2e,%.2e) m: %.2e ", l, s, q->x,q->y,q->mass);
-  putchar(']'); 
-  putchar('\n');
+  fputc(']', f); 
+  fputc('\n', f);
   print_tree_aux(f, mode, l+1, "NE",q->NE);
   print_tree_aux(f, mode, l+1,"NW",q->NW);
   print_tree_aux(f, mode, l+1,"SE",q->SE);
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+
+#define LINE_LENGTH 1024 // longest line of a text file of bodies
+
+
+int check_header(const snap_header_t *header, size_t file_size);
+size_t align_offset(size_t offset);
+int write_padding(FILE *f, size_t from, size_t to);
+int grow(double **array, size_t cap);
+
+
+int snapshot_open(snapshot_t *snap, const char *path){
+	/*
+	maps in memory the snapshot file 'path'
+
+	returns 0 if the file was mapped succesfully
+	returns -1 if it can not be read or it is not a valid snapshot
+	*/
+
+	memset(snap, 0, sizeof(snapshot_t));
+
+	int fd = open(path, O_RDONLY);
+
+	if(fd < 0) return -1;
+
+	struct stat st;
+
+	if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(snap_header_t)){
+		close(fd);
+		return -1;
+	}
+
+	void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping stays valid once the file is closed
+	close(fd);
+
+	if(map == MAP_FAILED) return -1;
+
+	const snap_header_t *header = map;
+
+	if(check_header(header, (size_t) st.st_size) != 0){
+		munmap(map, (size_t) st.st_size);
+		return -1;
+	}
+
+	// the arrays are read once, front to back, by the tree builders
+	madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+	madvise(map, (size_t) st.st_size, MADV_WILLNEED);
+
+	const double *fields[SNAP_FIELDS];
+
+	for(int k=0; k<SNAP_FIELDS; k++){
+		fields[k] = (header->offset[k] == 0) ? NULL : (const double *) ((const char *) map + header->offset[k]);
+	}
+
+	snap->n = (size_t) header->n;
+	snap->flags = header->flags;
+	snap->s = header->s;
+	snap->x = fields[SNAP_X];
+	snap->y = fields[SNAP_Y];
+	snap->m = fields[SNAP_M];
+	snap->fx = fields[SNAP_FX];
+	snap->fy = fields[SNAP_FY];
+	snap->map = map;
+	snap->map_size = (size_t) st.st_size;
+
+	return 0;
+}
+
+
+void snapshot_close(snapshot_t *snap){
+	/*
+	unmaps the snapshot
+	*/
+
+	if(snap->map != NULL) munmap(snap->map, snap->map_size);
+
+	memset(snap, 0, sizeof(snapshot_t));
+}
+
+
+int snapshot_write(const char *path, size_t n, const double *x, const double *y, const double *m, const double *fx, const double *fy, uint32_t flags, double s){
+	/*
+	writes a snapshot file of n bodies holding the arrays that are not NULL
+
+	returns 0 if the file was written succesfully
+	returns -1 otherwise
+	*/
+
+	const double *fields[SNAP_FIELDS] = {x, y, m, fx, fy};
+	snap_header_t header;
+
+	memset(&header, 0, sizeof(snap_header_t));
+	memcpy(header.magic, SNAP_MAGIC, sizeof(header.magic));
+	header.version = SNAP_VERSION;
+	header.byte_order = SNAP_BYTE_ORDER;
+	header.flags = flags;
+	header.n = n;
+	header.s = s;
+
+	size_t end = align_offset(sizeof(snap_header_t));
+
+	for(int k=0; k<SNAP_FIELDS; k++){
+		if(fields[k] == NULL) continue;
+		header.offset[k] = end;
+		end = align_offset(end + sizeof(double)*n);
+	}
+
+	FILE *f = fopen(path, "wb");
+
+	if(f == NULL) return -1;
+
+	int retval = 0;
+	size_t pos = sizeof(snap_header_t);
+
+	if(fwrite(&header, sizeof(snap_header_t), 1, f) != 1) retval = -1;
+
+	for(int k=0; k<SNAP_FIELDS && retval == 0; k++){
+
+		if(fields[k] == NULL) continue;
+
+		if(write_padding(f, pos, header.offset[k]) != 0 || fwrite(fields[k], sizeof(double), n, f) != n) retval = -1;
+
+		pos = header.offset[k] + sizeof(double)*n;
+	}
+
+	if(fclose(f) != 0) retval = -1;
+
+	return retval;
+}
+
+
+long snapshot_from_text(const char *text_path, const char *snap_path, int sort, double s){
+	/*
+	converts the text file 'text_path' of bodies "x y m" to the snapshot
+	file 'snap_path' with the universe of radius s, the bodies being sorted
+	along its Z-order curve if 'sort' is not 0
+
+	returns the number of lines that are not a body, which are skipped
+	returns -1 if the files can not be read or written
+	*/
+
+	FILE *f = fopen(text_path, "r");
+
+	if(f == NULL) return -1;
+
+	char line[LINE_LENGTH];
+	double *x = NULL, *y = NULL, *m = NULL;
+	size_t n = 0, cap = 0;
+	long skipped = 0;
+	int failed = 0;
+
+	while(fgets(line, LINE_LENGTH, f) != NULL){
+
+		double bx, by, bm;
+
+		if(string_to_body(line, &bx, &by, &bm) != 0){
+			skipped++;
+			continue;
+		}
+
+		if(n == cap){
+			cap = (cap == 0) ? 1024 : 2*cap;
+			if(grow(&x, cap) != 0 || grow(&y, cap) != 0 || grow(&m, cap) != 0){
+				failed = 1;
+				break;
+			}
+		}
+
+		x[n] = bx;
+		y[n] = by;
+		m[n] = bm;
+		n++;
+	}
+
+	fclose(f);
+
+	uint32_t flags = 0;
+
+	// the sorted flag needs a universe to refer to
+	if(!failed && sort && s <= 0){
+		const double *xs[2] = {x, y};
+		s = ntree2_fit_radius(xs, 1, n);
+	}
+
+	// the bodies are gathered in Z-order one array at a time
+	if(!failed && sort && n > 0){
+
+		uint32_t *perm = malloc(sizeof(uint32_t)*n);
+		double *tmp = malloc(sizeof(double)*n);
+
+		if(perm == NULL || tmp == NULL || morton_order(perm, x, y, n, s) != 0) failed = 1;
+
+		double *arrays[3] = {x, y, m};
+
+		for(int k=0; k<3 && !failed; k++){
+			for(size_t i=0; i<n; i++){
+				tmp[i] = arrays[k][perm[i]];
+			}
+			memcpy(arrays[k], tmp, sizeof(double)*n);
+		}
+
+		free(perm);
+		free(tmp);
+
+		flags |= SNAP_MORTON_SORTED;
+	}
+
+	if(!failed && snapshot_write(snap_path, n, x, y, m, NULL, NULL, flags, s) != 0) failed = 1;
+
+	free(x);
+	free(y);
+	free(m);
+
+	if(failed) return -1;
+
+	return skipped;
+}
+
+
+int snapshot_tree(linear_tree_t *t, const snapshot_t *snap, int leaf_size){
+	/*
+	builds the linear quadtree of the bodies of the snapshot, using the
+	mapped arrays in place if the snapshot is sorted
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+
+	if(snap->x == NULL || snap->y == NULL || snap->m == NULL) return -1;
+
+	if(snap->flags & SNAP_MORTON_SORTED){
+		return linear_tree_build_sorted(t, snap->x, snap->y, snap->m, snap->n, snap->s, leaf_size);
+	}
+
+	return linear_tree_build(t, snap->x, snap->y, snap->m, snap->n, snap->s, leaf_size);
+}
+
+
+////////////////////...UTILITY FUNCTIONS...////////////////////////////////
+int check_header(const snap_header_t *header, size_t file_size){
+	/*
+	returns 0 if 'header' is the one of a valid snapshot
+	of 'file_size' bytes, -1 otherwise
+	*/
+
+	if(memcmp(header->magic, SNAP_MAGIC, sizeof(header->magic)) != 0) return -1;
+	if(header->version != SNAP_VERSION) return -1;
+
+	// written on a machine of different endianness
+	if(header->byte_order != SNAP_BYTE_ORDER) return -1;
+
+	if(header->n > (file_size - sizeof(snap_header_t))/sizeof(double)) return -1;
+
+	size_t bytes = sizeof(double)*(size_t) header->n;
+
+	for(int k=0; k<SNAP_FIELDS; k++){
+
+		uint64_t offset = header->offset[k];
+
+		if(offset == 0) continue;
+
+		// every array has to be aligned and inside the file
+		if(offset % SNAP_ALIGN != 0 || offset < sizeof(snap_header_t)) return -1;
+		if(offset > file_size || file_size - offset < bytes) return -1;
+	}
+
+	if((header->flags & SNAP_MORTON_SORTED) && !(header->s > 0)) return -1;
+
+	return 0;
+}
+
+
+size_t align_offset(size_t offset){
+	/*
+	returns the first multiple of SNAP_ALIGN not smaller than 'offset'
+	*/
+
+	return (offset + SNAP_ALIGN - 1)/SNAP_ALIGN*SNAP_ALIGN;
+}
+
+
+int write_padding(FILE *f, size_t from, size_t to){
+	/*
+	writes zeros from the position 'from' to the position 'to' of the file
+
+	returns 0 if the padding was written succesfully
+	returns -1 otherwise
+	*/
+
+	static const char zeros[SNAP_ALIGN] = {0};
+
+	if(to - from > 0 && fwrite(zeros, 1, to - from, f) != to - from) return -1;
+
+	return 0;
+}
+
+
+int grow(double **array, size_t cap){
+	/*
+	reallocates the array to 'cap' elements
+
+	returns 0 if the array was reallocated succesfully
+	returns -1 otherwise, the old array being left untouched
+	*/
+
+	double *p = realloc(*array, sizeof(double)*cap);
+
+	if(p == NULL) return -1;
+
+	*array = p;
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef __SNAPSHOT__H
+#define __SNAPSHOT__H
+#include <stddef.h>
+#include <stdint.h>
+#include "linear_tree.h"
+
+
+#define SNAP_MAGIC "BHSNAP\0" // first 8 bytes of a snapshot file
+#define SNAP_VERSION 1
+#define SNAP_BYTE_ORDER 0x01020304 // written as it is, to detect the endianness
+#define SNAP_ALIGN 64 // alignment of the arrays in the file
+
+// flags of a snapshot
+#define SNAP_MORTON_SORTED 1 // bodies sorted along the Z-order curve of radius s
+
+// arrays a snapshot can hold, in the order they are stored
+enum {SNAP_X, SNAP_Y, SNAP_M, SNAP_FX, SNAP_FY, SNAP_FIELDS};
+
+// header at the beginning of a snapshot file
+//
+// the header is followed by the arrays of n doubles present in the file,
+// each one starting at 'offset' bytes from the beginning of the file
+// (a multiple of SNAP_ALIGN), 0 for the arrays not present
+typedef struct snap_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t n;
+
+  // radius of the universe of the Z-order curve, 0 if not sorted
+  double s;
+
+  uint64_t offset[SNAP_FIELDS];
+} snap_header_t;
+
+// snapshot mapped in memory
+typedef struct snapshot {
+  size_t n;
+  uint32_t flags;
+  double s;
+
+  // arrays of the file, NULL if not present
+  const double *x, *y, *m;
+  const double *fx, *fy;
+
+  // mapping of the whole file
+  void *map;
+  size_t map_size;
+} snapshot_t;
+
+
+	/*
+	maps in memory the snapshot file 'path', the arrays of 'snap' point
+	directly to the mapped file (read only), nothing is parsed or copied
+
+	returns 0 if the file was mapped succesfully
+	returns -1 if it can not be read or it is not a valid snapshot
+	*/
+int snapshot_open (snapshot_t * snap, const char * path);
+
+
+	/*
+	unmaps the snapshot, the arrays can not be used any longer
+	*/
+void snapshot_close (snapshot_t * snap);
+
+
+	/*
+	writes a snapshot file of n bodies holding the arrays that are not NULL,
+	e.g. the forces (fx,fy) calculated on the bodies of another snapshot;
+	'flags' and the radius s are stored in the header as they are
+
+	returns 0 if the file was written succesfully
+	returns -1 otherwise
+	*/
+int snapshot_write (const char * path, size_t n, const double * x, const double * y, const double * m, const double * fx, const double * fy, uint32_t flags, double s);
+
+
+	/*
+	converts the text file 'text_path', one body per line formatted
+	as in 'string_to_body', to the snapshot file 'snap_path' with the
+	universe of radius s stored in the header; if 'sort' is not 0 the
+	bodies are stored along the Z-order curve of that universe, which
+	is fitted to the bodies if s <= 0
+
+	returns the number of lines that are not a body, which are skipped
+	returns -1 if the files can not be read or written
+	*/
+long snapshot_from_text (const char * text_path, const char * snap_path, int sort, double s);
+
+
+	/*
+	builds the linear quadtree of the bodies of the snapshot: if the
+	snapshot is sorted the tree uses the mapped arrays in place (see
+	'linear_tree_build_sorted'), so the snapshot must stay open as long
+	as the tree is used, otherwise the bodies are read from the mapped
+	arrays by 'linear_tree_build' in the universe of radius of the header
+
+	returns 0 if the tree was built succesfully
+	returns -1 otherwise
+	*/
+int snapshot_tree (linear_tree_t * t, const snapshot_t * snap, int leaf_size);
+#endif
@@ -1,161 +1,857 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <math.h>
+#include "union_find.h"
+#include "rng.h"
+#include "stats.h"
+
+
+#define LINK_BLOCK 1024 // links drawn at once
+#define MEASURE_BLOCK 16 // least measures summed by a thread before joining the totals
+#define MAX_BLOCKS 1024 // most blocks of measures of a size, whose sums are kept until the end
+#define MAX_RUNS 64 // most system sizes in a single job
+#define LINK_CHUNK 65536 // links drawn from the same stream by a thread of a concurrent graph
+#ifndef PREFETCH_DISTANCE
+#define PREFETCH_DISTANCE 16 // links ahead whose nodes are prefetched, 0 for none
+#endif
+
+
+// a system size of a job, with its values of the order parameter
+struct Run{
+    unsigned long long int n; // nodes in the graph
+    int measures; // number of datapoints for each order parameter value
+    // order parameter values, m from c_min with step (c_max-c_min)/m
+    double c_min, c_max;
+    int m;
+    double *c_list;
+    // mean, variance and standard error over the measures of the
+    // observables (S' and S_max over N) for each order parameter value
+    struct RunningStat *smean;
+    struct RunningStat *smax;
+    // observables of every measure if the raw data is asked, NULL
+    // otherwise, the ones of the i-th measure starting from i*m
+    unsigned long long int *mean_clust_size;
+    unsigned long long int *max_clust_size;
+};
 
 
-struct ConnComp{
-    struct ConnComp *parent; // node identifying the cluster
-    unsigned int size; // size of the connected cluster
-};
+// ways of evolving the graphs
+#define MODE_SWEEP 0 // a single graph through all the values of c for every trajectory
+#define MODE_REBUILD 1 // a new graph for each value of c
+#define MODE_CONCURRENT 2 // as MODE_SWEEP, but all the threads on the same graph
 
 
-struct ConnComp *initialize(unsigned long long int n);
-struct ConnComp *component_of(struct ConnComp *pcomp);
-unsigned int merge_components(struct ConnComp *pcomp1, struct ConnComp *pcomp2);
-void generate_list(double *list, int m);
-unsigned long long int get_node(unsigned long long int n);
+int run_measures(struct Run *runs, int n_runs, int mode, uint64_t seed);
+void trajectory_sweep(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size);
+void trajectory_rebuild(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size);
+int trajectory_concurrent(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size);
+void add_links(struct UnionFind *comp, const uf_index *site1, const uf_index *site2, int count, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size);
+void get_links(struct Rng *rng, unsigned long long int n, uf_index *site1, uf_index *site2, int count);
+int run_alloc(struct Run *run, int raw);
+void run_free(struct Run *run);
+int write_summary(const struct Run *run);
+int write_raw(const struct Run *run);
+int read_config(const char *path, struct Run *runs, int max);
+int parse_list(const char *s, double *values, int max);
+int parse_range(const char *s, double *c_min, double *c_max, int *m);
+void generate_list(double *list, int m, double c_min, double c_max);
+void usage(const char *name);
 
 
-int main(){
+int main(int argc, char **argv){
+    /*
+    percolation trajectories of every system size asked, all the sizes
+    sharing the cores, writing for every size N the summary table
+    nN_summary.txt (and the observables of every measure in nN.txt if
+    asked)
 
-    unsigned long long int n = 1000; // nodes in the graph
-    // array of connected components, every element is a node but not
-    // all nodes corresponds to the parent of a connected component,
-    // only when comp->parent = comp is the case
-    struct ConnComp *comp;
-    unsigned long long int mean_clust_size;
-    unsigned int max_clust_size;
+    e.g. ./perc_rand_graphs -n 1e3,1e4,1e5,1e6 -c 0:2:100 -M 1000
+    */
+
+    double sizes[MAX_RUNS] = {1000};
+    int n_sizes = 1;
+    double c_min = 0, c_max = 2;
     int m = 100; // number of order parameter values used in the simulation
-    double c_list[m];
-    int measures = 1000; // number of datapoints for each order parameter value
-    unsigned long long int site1, site2;
-    struct ConnComp *pcomp1, *pcomp2;
-    unsigned int new_size;
-    srand(time(0));
-    FILE *pf_trajectories;
+    int measures = 1000;
+    struct Run runs[MAX_RUNS];
+    int n_runs;
+    const char *config = NULL;
+    // 1 if the sizes, values of c or measures are given on the command
+    // line, which cannot be mixed with the ones of a config file
+    int command_line = 0;
+    // 1 to also write the observables of every measure
+    int raw = 0;
+    // a single graph through all the values of c for every trajectory (one
+    // graph build per trajectory) unless asked otherwise
+    int mode = MODE_SWEEP;
+    // the same seed gives the same data, whatever the number of threads
+    uint64_t seed = (uint64_t) time(0);
+
+    for(int a=1; a<argc; a++){
+
+        const char *value = (a+1 < argc) ? argv[a+1] : NULL;
+
+        if(value == NULL){
+            usage(argv[0]);
+            return 1;
+        }
+
+        if(strcmp(argv[a], "-n") == 0){
+            n_sizes = parse_list(value, sizes, MAX_RUNS);
+            command_line = 1;
+        }
+        else if(strcmp(argv[a], "-c") == 0){
+            if(parse_range(value, &c_min, &c_max, &m) != 0){
+                usage(argv[0]);
+                return 1;
+            }
+            command_line = 1;
+        }
+        else if(strcmp(argv[a], "-M") == 0){
+            measures = atoi(value);
+            command_line = 1;
+        }
+        else if(strcmp(argv[a], "-f") == 0) config = value;
+        else if(strcmp(argv[a], "-s") == 0) seed = strtoull(value, NULL, 10);
+        else if(strcmp(argv[a], "-r") == 0) raw = atoi(value);
+        else if(strcmp(argv[a], "-m") == 0){
+            if(strcmp(value, "sweep") == 0) mode = MODE_SWEEP;
+            else if(strcmp(value, "rebuild") == 0) mode = MODE_REBUILD;
+            else if(strcmp(value, "concurrent") == 0) mode = MODE_CONCURRENT;
+            else{
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else{
+            usage(argv[0]);
+            return 1;
+        }
+
+        a++;
+    }
 
-    generate_list(c_list, m);
+    if(n_sizes <= 0 || (config != NULL && command_line)){
+        usage(argv[0]);
+        return 1;
+    }
 
-    pf_trajectories = fopen("n1000.txt", "w");
-    
-    // measures
-    for(int i=0; i<measures; i++){
-        
-		// trajectory in function of the order parameter
-		for(int c=0; c<m; c++){
-
-            comp = initialize(n);
-			mean_clust_size = (unsigned long long int) n;
-			max_clust_size = (unsigned int) 1;
-            
-			// evolution of the graph, a graph of average degree c and N nodes has cN/2 links 
-			for(int j=0; j < (int) (c_list[c]*n*0.5); j++){
-                
-				site1 = get_node(n);
-                
-                do{
-                    site2 = get_node(n);
-                }while(site1 == site2);
-                
-				pcomp1 = component_of(comp + site1);
-                pcomp2 = component_of(comp + site2);
-                
-				if(pcomp1 != pcomp2){
-
-					mean_clust_size += 2*(unsigned long long int) pcomp1->size*pcomp2->size;
-					new_size = merge_components(pcomp1, pcomp2);
-	
-					if(new_size > max_clust_size){
-						max_clust_size = new_size;
-					}
-				}            
-			}
-
-            // the (square) of the largest cluster size have to be subtracted from mean_clust_size
-            // in order to remove the dominating component and actually see the divergence for c=1
-            fprintf(pf_trajectories, "%f\t%f\t%f\n", c_list[c], (float)  (mean_clust_size-pow(max_clust_size,2))/n, (float) max_clust_size/n);
-            free(comp);
-		}
+    if(config != NULL){
 
-        fprintf(pf_trajectories, "\n");
+        n_runs = read_config(config, runs, MAX_RUNS);
+
+        if(n_runs < 0){
+            fprintf(stderr, "cannot read the sizes of %s\n", config);
+            return 1;
+        }
+    }
+    else{
+
+        n_runs = n_sizes;
+
+        for(int j=0; j<n_sizes; j++){
+            runs[j].n = (unsigned long long int) sizes[j];
+            runs[j].measures = measures;
+            runs[j].c_min = c_min;
+            runs[j].c_max = c_max;
+            runs[j].m = m;
+        }
+    }
+
+    // every size has files of its own
+    for(int j=0; j<n_runs; j++){
+
+        int valid = runs[j].n >= 2 && runs[j].measures > 0 && runs[j].m > 0;
+
+        for(int k=0; k<j; k++){
+            if(runs[k].n == runs[j].n) valid = 0;
+        }
+
+        if(!valid){
+            usage(argv[0]);
+            return 1;
+        }
+
+        // the nodes are indexed by uf_index, 32 bits by default
+        if(runs[j].n > (unsigned long long int) UF_MAX_NODES){
+            fprintf(stderr, "%llu nodes are more than the %lld of the node indices, compile with -DUF_INDEX64\n", runs[j].n, (long long int) UF_MAX_NODES);
+            return 1;
+        }
     }
 
-    fclose(pf_trajectories);
+    for(int j=0; j<n_runs; j++){
+
+        if(run_alloc(runs + j, raw) != 0){
+            fprintf(stderr, "cannot allocate the observables of %d measures\n", runs[j].measures);
+            return 1;
+        }
+
+        generate_list(runs[j].c_list, runs[j].m, runs[j].c_min, runs[j].c_max);
+    }
+
+    if(run_measures(runs, n_runs, mode, seed) != 0){
+        fprintf(stderr, "cannot allocate the graphs\n");
+        return 1;
+    }
+
+    for(int j=0; j<n_runs; j++){
+
+        if(write_summary(runs + j) != 0 || (raw && write_raw(runs + j) != 0)){
+            fprintf(stderr, "cannot write the data of %llu nodes\n", runs[j].n);
+            return 1;
+        }
+
+        run_free(runs + j);
+    }
 
     return 0;
 }
 
 
-struct ConnComp *initialize(unsigned long long int n){
+int run_measures(struct Run *runs, int n_runs, int mode, uint64_t seed){
     /*
-    at the beginning every separate node is a single
-    connected component of size 1
+    trajectories of all the measures of all the runs, spread over the
+    threads (if compiled with OpenMP) in blocks of consecutive measures of
+    the same size, the blocks of the largest sizes first so the smaller
+    ones fill in the cores left free at the end; in MODE_CONCURRENT the
+    blocks are run one after the other, all the threads working on the
+    links of the same graph
+
+    the i-th measure of the size n draws its links from the subspace of
+    the generator seeded with seed+n and long jumped i times (2^192
+    numbers, split in streams by 'trajectory_concurrent'), so the
+    measures are independent and the data of a size does not depend on the other sizes
+    of the job; the blocks of a size are joined in order at the end, so the
+    results are the same whatever thread runs them
+
+    returns 0 if the measures were done succesfully
+    returns -1 if the graphs could not be allocated
     */
 
-    struct ConnComp *comp;
-    comp = malloc(sizeof(struct ConnComp)*n);
+    // blocks of the j-th run, the first one being the first[j]-th of the
+    // job, and length of a block
+    int first[MAX_RUNS + 1];
+    int block[MAX_RUNS];
+    // runs from the largest size
+    int order[MAX_RUNS];
+    unsigned long long int max_n = 2;
+    int max_m = 1;
+    int failed = 0;
+
+    for(int j=0; j<n_runs; j++){
+
+        int k = j;
+
+        while(k > 0 && runs[order[k-1]].n < runs[j].n){
+            order[k] = order[k-1];
+            k--;
+        }
+
+        order[k] = j;
+
+        block[j] = (runs[j].measures + MAX_BLOCKS - 1)/MAX_BLOCKS;
+        if(block[j] < MEASURE_BLOCK) block[j] = MEASURE_BLOCK;
+
+        if(runs[j].n > max_n) max_n = runs[j].n;
+        if(runs[j].m > max_m) max_m = runs[j].m;
+    }
+
+    first[0] = 0;
+
+    for(int j=0; j<n_runs; j++){
+        first[j+1] = first[j] + (runs[j].measures + block[j] - 1)/block[j];
+    }
+
+    int blocks = first[n_runs];
+
+    // the blocks in the order they are run, the stream of the first measure
+    // of every block and the statistics of every block (the ones of S'
+    // then the ones of S_max)
+    int *schedule = malloc(sizeof(int)*(blocks > 0 ? blocks : 1));
+    struct Rng *streams = malloc(sizeof(struct Rng)*(blocks > 0 ? blocks : 1));
+    struct RunningStat **block_stats = calloc(blocks > 0 ? blocks : 1, sizeof(struct RunningStat*));
+
+    if(schedule == NULL || streams == NULL || block_stats == NULL) failed = 1;
+
+    for(int b=0; b<blocks && !failed; b++){
+        int j = 0;
+        while(first[j+1] <= b) j++;
+        block_stats[b] = malloc(sizeof(struct RunningStat)*2*runs[j].m);
+        if(block_stats[b] == NULL) failed = 1;
+    }
+
+    for(int k=0, b=0; k<n_runs && !failed; k++){
+
+        int j = order[k];
+        struct Rng rng;
+
+        rng_seed(&rng, seed + runs[j].n);
+
+        for(int i=0; i<runs[j].measures; i++){
+
+            if(i % block[j] == 0){
+                streams[first[j] + i/block[j]] = rng;
+                schedule[b++] = first[j] + i/block[j];
+            }
+
+            rng_long_jump(&rng);
+        }
+    }
+
+    #pragma omp parallel if(!failed && mode != MODE_CONCURRENT)
+    {
+        // every thread reuses buffers of its own for all its graphs,
+        // large enough for the largest size (a single one shared by
+        // all the threads in MODE_CONCURRENT)
+        struct UnionFind comp;
+        unsigned long long int *mean_buf = malloc(sizeof(unsigned long long int)*max_m);
+        unsigned long long int *max_buf = malloc(sizeof(unsigned long long int)*max_m);
+        int ok = !failed && uf_init(&comp, max_n) == 0 && mean_buf != NULL && max_buf != NULL;
+
+        if(!ok){
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for(int k=0; k<blocks; k++){
+
+            if(!ok) continue;
+
+            int b = schedule[k];
+            int j = 0;
+
+            while(first[j+1] <= b) j++;
+
+            const struct Run *run = runs + j;
+            int m = run->m;
+            unsigned long long int n = run->n;
+            struct RunningStat *bmean = block_stats[b];
+            struct RunningStat *bmax = bmean + m;
+            struct Rng stream = streams[b];
+            // the components of the first n nodes of the buffer
+            struct UnionFind view = comp;
+
+            view.n = (uf_index) n;
+
+            for(int c=0; c<m; c++){
+                stat_reset(bmean + c);
+                stat_reset(bmax + c);
+            }
+
+            for(int i=(b-first[j])*block[j]; i<run->measures && i<(b-first[j]+1)*block[j]; i++){
+
+                unsigned long long int *mean = run->mean_clust_size != NULL ? run->mean_clust_size + (size_t) i*m : mean_buf;
+                unsigned long long int *max = run->max_clust_size != NULL ? run->max_clust_size + (size_t) i*m : max_buf;
+                // the subspace of the measure, the next one starting 2^192 numbers later
+                struct Rng rng = stream;
+
+                rng_long_jump(&stream);
+
+                // trajectory in function of the order parameter
+                if(mode == MODE_SWEEP){
+                    trajectory_sweep(&view, &rng, n, run->c_list, m, mean, max);
+                }
+                else if(mode == MODE_REBUILD){
+                    trajectory_rebuild(&view, &rng, n, run->c_list, m, mean, max);
+                }
+                else if(trajectory_concurrent(&view, &rng, n, run->c_list, m, mean, max) != 0){
+                    #pragma omp atomic write
+                    failed = 1;
+                    break;
+                }
+
+                // the (square) of the largest cluster size have to be subtracted from mean_clust_size
+                // in order to remove the dominating component and actually see the divergence for c=1
+                for(int c=0; c<m; c++){
+                    stat_add(bmean + c, ((double) mean[c] - (double) max[c]*max[c])/n);
+                    stat_add(bmax + c, (double) max[c]/n);
+                }
+            }
+        }
+
+        if(ok) uf_free(&comp);
+        free(mean_buf);
+        free(max_buf);
+    }
+
+    for(int j=0; j<n_runs && !failed; j++){
+        for(int c=0; c<runs[j].m; c++){
 
-    for(int i=0; i<n; i++){
-        comp[i].parent = comp + i;
-        comp[i].size = (unsigned int) 1;
+            stat_reset(runs[j].smean + c);
+            stat_reset(runs[j].smax + c);
+
+            for(int b=first[j]; b<first[j+1]; b++){
+                stat_merge(runs[j].smean + c, block_stats[b] + c);
+                stat_merge(runs[j].smax + c, block_stats[b] + runs[j].m + c);
+            }
+        }
+    }
+
+    for(int b=0; b<blocks && block_stats != NULL; b++){
+        free(block_stats[b]);
     }
 
-    return comp;
+    free(schedule);
+    free(streams);
+    free(block_stats);
+
+    return failed ? -1 : 0;
 }
 
 
-struct ConnComp *component_of(struct ConnComp *pcomp){
+void trajectory_sweep(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size){
     /*
-    returns the connected component a certain element belongs to
+    evolution of a single graph through all the values of c_list, which
+    have to be increasing: the graph of a value of c is the one of the
+    previous value with more links, so the links are added only once and
+    the observables are recorded every time their number reaches the one
+    of the next value of c (Newman-Ziff)
+
+    the observables of the different values of c then come from the same
+    graph, so they are correlated within a trajectory but have the same
+    ensemble averages as the ones of separate graphs
     */
 
-    while(pcomp->parent != pcomp){
-        pcomp = pcomp->parent;
+    unsigned long long int mean = n;
+    unsigned long long int max = 1;
+    unsigned long long int links = 0;
+    uf_index site1[LINK_BLOCK], site2[LINK_BLOCK];
+
+    uf_reset(comp);
+
+    for(int c=0; c<m; c++){
+
+        // a graph of average degree c and N nodes has cN/2 links
+        unsigned long long int target = (unsigned long long int) (c_list[c]*n*0.5);
+
+        while(links < target){
+
+            int count = target - links < LINK_BLOCK ? (int) (target - links) : LINK_BLOCK;
+
+            get_links(rng, n, site1, site2, count);
+            add_links(comp, site1, site2, count, &mean, &max);
+            links += count;
+        }
+
+        mean_clust_size[c] = mean;
+        max_clust_size[c] = max;
     }
-    return pcomp;
 }
 
 
-unsigned int merge_components(struct ConnComp *pcomp1, struct ConnComp *pcomp2){
+void trajectory_rebuild(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size){
     /*
-    merges the smallest cluster into the largest
+    evolution of a new graph from no links for every value of c_list,
+    i.e. the observables of the different values are independent
     */
 
-    if(pcomp1->size < pcomp2->size){
-        pcomp1->parent = pcomp2;
-        pcomp2->size += pcomp1->size;
-        return pcomp2->size;
+    uf_index site1[LINK_BLOCK], site2[LINK_BLOCK];
+
+    for(int c=0; c<m; c++){
+
+        unsigned long long int target = (unsigned long long int) (c_list[c]*n*0.5);
+
+        uf_reset(comp);
+        mean_clust_size[c] = n;
+        max_clust_size[c] = 1;
+
+        for(unsigned long long int links=0; links < target; ){
+
+            int count = target - links < LINK_BLOCK ? (int) (target - links) : LINK_BLOCK;
+
+            get_links(rng, n, site1, site2, count);
+            add_links(comp, site1, site2, count, mean_clust_size + c, max_clust_size + c);
+            links += count;
+        }
     }
-    else{
-        pcomp2->parent = pcomp1;
-        pcomp1->size += pcomp2->size;
-        return pcomp1->size;
+}
+
+
+int trajectory_concurrent(struct UnionFind *comp, struct Rng *rng, unsigned long long int n, const double *c_list, int m, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size){
+    /*
+    same as 'trajectory_sweep' with all the threads adding the links of the
+    same graph at once ('uf_union_atomic'), e.g. for a single graph too
+    large to have a copy for every thread
+
+    the links up to the next value of c are cut in chunks of LINK_CHUNK,
+    each one drawn from a stream of its own: the chunks of all the values
+    of c take the consecutive streams of 2^128 numbers of the subspace of
+    the measure (rng is jumped once more for every chunk and is left past
+    the last one), so no two chunks of any measure overlap and the graph is
+    the same whatever thread adds a chunk; once all the links are added the observables
+    are calculated from the sizes of the roots, and are exact, while the
+    order of the links only changes the shape of the trees
+
+    returns 0 if the trajectory was calculated succesfully
+    returns -1 if the streams could not be allocated
+    */
+
+    unsigned long long int links = 0;
+    int failed = 0;
+
+    #pragma omp parallel for schedule(static)
+    for(uf_index i=0; i<comp->n; i++){
+        comp->parent[i] = -1;
     }
+
+    for(int c=0; c<m && !failed; c++){
+
+        unsigned long long int target = (unsigned long long int) (c_list[c]*n*0.5);
+        long long int chunks = (long long int) ((target - links + LINK_CHUNK - 1)/LINK_CHUNK);
+        struct Rng *streams = malloc(sizeof(struct Rng)*(chunks > 0 ? chunks : 1));
+        unsigned long long int sum_squares = 0;
+        unsigned long long int max = 0;
+
+        if(streams == NULL){
+            failed = 1;
+            break;
+        }
+
+        for(long long int k=0; k<chunks; k++){
+            streams[k] = *rng;
+            rng_jump(rng);
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for(long long int k=0; k<chunks; k++){
+
+            uf_index site1[LINK_BLOCK], site2[LINK_BLOCK];
+            unsigned long long int start = links + (unsigned long long int) k*LINK_CHUNK;
+            unsigned long long int end = start + LINK_CHUNK < target ? start + LINK_CHUNK : target;
+
+            for(unsigned long long int j=start; j<end; ){
+
+                int count = end - j < LINK_BLOCK ? (int) (end - j) : LINK_BLOCK;
+
+                get_links(streams + k, n, site1, site2, count);
+
+                for(int l=0; l<count; l++){
+                    uf_union_atomic(comp, site1[l], site2[l]);
+                }
+
+                j += count;
+            }
+        }
+
+        free(streams);
+        links = target > links ? target : links;
+
+        // the sum of the squares of the cluster sizes is the one updated
+        // link by link by 'add_links', as it starts from n for no links
+        #pragma omp parallel for schedule(static) reduction(+:sum_squares) reduction(max:max)
+        for(uf_index i=0; i<comp->n; i++){
+
+            uf_index p = comp->parent[i];
+
+            if(p < 0){
+
+                unsigned long long int size = (unsigned long long int) -p;
+
+                sum_squares += size*size;
+                if(size > max) max = size;
+            }
+        }
+
+        mean_clust_size[c] = sum_squares;
+        max_clust_size[c] = max;
+    }
+
+    return failed ? -1 : 0;
 }
 
 
-void generate_list(double *list, int m){
+void add_links(struct UnionFind *comp, const uf_index *site1, const uf_index *site2, int count, unsigned long long int *mean_clust_size, unsigned long long int *max_clust_size){
     /*
-    list of order parameter c (average degree of the graph) values
+    adds the links between site1[i] and site2[i], updating the sum
+    of the squares of the cluster sizes and the largest cluster size
+
+    the links are added one after the other, but the nodes of the link
+    PREFETCH_DISTANCE places ahead are prefetched, and the parents of the
+    ones half that distance ahead (whose entries have arrived by then), so
+    in a large graph the lookups do not wait for the memory one at a time
     */
 
+    uf_index root1, root2;
+    unsigned long long int new_size;
+
+    for(int i=0; i<count; i++){
+
+#if PREFETCH_DISTANCE > 0
+        if(i + PREFETCH_DISTANCE < count){
+            uf_prefetch(comp, site1[i + PREFETCH_DISTANCE]);
+            uf_prefetch(comp, site2[i + PREFETCH_DISTANCE]);
+        }
+
+        if(i + PREFETCH_DISTANCE/2 < count){
+            uf_prefetch_parent(comp, site1[i + PREFETCH_DISTANCE/2]);
+            uf_prefetch_parent(comp, site2[i + PREFETCH_DISTANCE/2]);
+        }
+#endif
+
+        root1 = uf_find(comp, site1[i]);
+        root2 = uf_find(comp, site2[i]);
+
+        if(root1 != root2){
+
+            // (S1+S2)^2 - S1^2 - S2^2
+            *mean_clust_size += 2*(unsigned long long int) uf_size(comp, root1)*uf_size(comp, root2);
+            new_size = (unsigned long long int) uf_link(comp, root1, root2);
+
+            if(new_size > *max_clust_size){
+                *max_clust_size = new_size;
+            }
+        }
+    }
+}
+
+
+void get_links(struct Rng *rng, unsigned long long int n, uf_index *site1, uf_index *site2, int count){
+    /*
+    'count' links between two different random nodes, every pair having
+    the same probability: the second node is drawn among the n-1 nodes
+    other than the first one, so there are no self loops to draw again
+    */
+
+#ifdef UF_INDEX64
+    for(int i=0; i<count; i++){
+        site1[i] = (uf_index) rng_below(rng, n);
+        site2[i] = (uf_index) rng_below(rng, n-1);
+    }
+#else
+    rng_fill_below(rng, (uint32_t) n, (uint32_t *) site1, count);
+    rng_fill_below(rng, (uint32_t) (n-1), (uint32_t *) site2, count);
+#endif
+
+    for(int i=0; i<count; i++){
+        site2[i] += site2[i] >= site1[i];
+    }
+}
+
+
+int run_alloc(struct Run *run, int raw){
+    /*
+    allocates the order parameter values and the observables of a run,
+    the ones of every measure only if 'raw' is not 0
+
+    returns 0 if the run was allocated succesfully
+    returns -1 otherwise
+    */
+
+    run->c_list = malloc(sizeof(double)*run->m);
+    run->smean = malloc(sizeof(struct RunningStat)*run->m);
+    run->smax = malloc(sizeof(struct RunningStat)*run->m);
+    run->mean_clust_size = NULL;
+    run->max_clust_size = NULL;
+
+    if(raw){
+        run->mean_clust_size = malloc(sizeof(unsigned long long int)*run->measures*run->m);
+        run->max_clust_size = malloc(sizeof(unsigned long long int)*run->measures*run->m);
+    }
+
+    if(run->c_list == NULL || run->smean == NULL || run->smax == NULL || (raw && (run->mean_clust_size == NULL || run->max_clust_size == NULL))){
+        run_free(run);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void run_free(struct Run *run){
+    /*
+    deallocates the order parameter values and the observables of a run
+    */
+
+    free(run->c_list);
+    free(run->smean);
+    free(run->smax);
+    free(run->mean_clust_size);
+    free(run->max_clust_size);
+
+    run->c_list = NULL;
+    run->smean = run->smax = NULL;
+    run->mean_clust_size = run->max_clust_size = NULL;
+}
+
+
+int write_summary(const struct Run *run){
+    /*
+    writes in nN_summary.txt, for each order parameter value, the mean,
+    variance and standard error of S' and S_max over N
+
+    returns 0 if the file was written succesfully
+    returns -1 otherwise
+    */
+
+    char name[64];
+    FILE *pf_summary;
+
+    snprintf(name, sizeof(name), "n%llu_summary.txt", run->n);
+    pf_summary = fopen(name, "w");
+
+    if(pf_summary == NULL) return -1;
+
+    fprintf(pf_summary, "# c\tS'\tvar(S')\terr(S')\tS_max\tvar(S_max)\terr(S_max)\n");
+
+    for(int c=0; c<run->m; c++){
+        fprintf(pf_summary, "%f\t%e\t%e\t%e\t%e\t%e\t%e\n", run->c_list[c], run->smean[c].mean, stat_variance(run->smean + c), stat_error(run->smean + c), run->smax[c].mean, stat_variance(run->smax + c), stat_error(run->smax + c));
+    }
+
+    return fclose(pf_summary) == 0 ? 0 : -1;
+}
+
+
+int write_raw(const struct Run *run){
+    /*
+    writes in nN.txt the observables of every measure, a line for each
+    order parameter value and an empty line after every measure
+
+    returns 0 if the file was written succesfully
+    returns -1 otherwise
+    */
+
+    char name[64];
+    FILE *pf_trajectories;
+    unsigned long long int n = run->n;
+
+    snprintf(name, sizeof(name), "n%llu.txt", n);
+    pf_trajectories = fopen(name, "w");
+
+    if(pf_trajectories == NULL) return -1;
+
+    // measures
+    for(int i=0; i<run->measures; i++){
+
+        for(int c=0; c<run->m; c++){
+
+            unsigned long long int mean = run->mean_clust_size[(size_t) i*run->m + c];
+            unsigned long long int max = run->max_clust_size[(size_t) i*run->m + c];
+
+            fprintf(pf_trajectories, "%f\t%f\t%f\n", run->c_list[c], (float)  (mean-pow(max,2))/n, (float) max/n);
+        }
+
+        fprintf(pf_trajectories, "\n");
+    }
+
+    return fclose(pf_trajectories) == 0 ? 0 : -1;
+}
+
+
+int read_config(const char *path, struct Run *runs, int max){
+    /*
+    reads the sizes of a job from the file 'path', one for every line
+    as 'N measures c_min:c_max:m', the lines starting with # being
+    comments
+
+    returns the number of sizes read
+    returns -1 if the file cannot be read or is not valid
+    */
+
+    FILE *pf = fopen(path, "r");
+    char line[256];
+    char range[128];
+    double n;
+    int count = 0;
+
+    if(pf == NULL) return -1;
+
+    while(fgets(line, sizeof(line), pf) != NULL){
+
+        char *s = line + strspn(line, " \t");
+
+        if(*s == '#' || *s == '\n' || *s == '\0') continue;
+
+        if(count == max || sscanf(s, "%lf %d %127s", &n, &runs[count].measures, range) != 3 || !(n >= 2) || parse_range(range, &runs[count].c_min, &runs[count].c_max, &runs[count].m) != 0){
+            fclose(pf);
+            return -1;
+        }
+
+        runs[count].n = (unsigned long long int) n;
+        count++;
+    }
+
+    fclose(pf);
+
+    return count;
+}
+
+
+int parse_list(const char *s, double *values, int max){
+    /*
+    reads the comma separated numbers of 's' in 'values'
+
+    returns the number of values read
+    returns -1 if 's' is not a list of at most 'max' positive numbers
+    */
+
+    int count = 0;
+    char *end;
+
+    while(*s != '\0'){
+
+        if(count == max) return -1;
+
+        values[count] = strtod(s, &end);
+
+        if(end == s || !(values[count] > 0)) return -1;
+
+        count++;
+        s = end;
+
+        if(*s == ',') s++;
+            else if(*s != '\0') return -1;
+    }
+
+    return count;
+}
+
+
+int parse_range(const char *s, double *c_min, double *c_max, int *m){
+    /*
+    reads the order parameter values 'c_min:c_max:m'
+
+    returns 0 if 's' is a valid range
+    returns -1 otherwise
+    */
+
+    char end;
+
+    if(sscanf(s, "%lf:%lf:%d%c", c_min, c_max, m, &end) != 3) return -1;
+
+    if(!(*c_min >= 0) || !(*c_max > *c_min) || *m <= 0) return -1;
+
+    return 0;
+}
+
+
+void generate_list(double *list, int m, double c_min, double c_max){
+    /*
+    list of order parameter c (average degree of the graph) values,
+    from c_min included to c_max excluded
+    */
+
+    double step = (c_max - c_min)/m;
+
     for(int i=0; i<m; i++){
-        list[i] = 0.02*i;
+        list[i] = c_min + step*i;
     }
 }
 
 
-unsigned long long int get_node(unsigned long long int n){
+void usage(const char *name){
     /*
-    random node index for n nodes
+    prints the options of the program
     */
-    
-    unsigned long long int x;
-    x = rand();
-    x <<= 15;
-    x ^= rand();
-    x %= n;
 
-    return x;
+    fprintf(stderr,
+        "usage: %s [-n sizes] [-c c_min:c_max:m] [-M measures] [-m sweep|rebuild|concurrent]\n"
+        "          [-s seed] [-r 0|1] [-f config]\n"
+        "  sizes is a comma separated list of different sizes, e.g. -n 1e3,1e6\n"
+        "  the m values of c go from c_min included to c_max excluded (0:2:100)\n"
+        "  -r 1 also writes the observables of every measure in nN.txt\n"
+        "  config has a line 'N measures c_min:c_max:m' for every size,\n"
+        "  so -f cannot be given together with -n, -c or -M\n", name);
 }
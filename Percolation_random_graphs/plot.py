@@ -1,5 +1,6 @@
 from matplotlib import pyplot as plt
 import numpy as np
+import os
 from itertools import groupby
 from scipy.optimize import curve_fit
 
@@ -16,11 +17,26 @@ def get_data(file):
 
     return np.mean(np.array(list), axis=0)
 
+def get_summary(file):
 
-n_1000 = get_data('n1000.txt')
-n_10000 = get_data('n10000.txt')
-n_100000 = get_data('n100000.txt')
-n_1000000 = get_data('n1000000.txt')
+    # means already computed by perc_rand_graphs.c, the columns being c and
+    # the mean, variance and standard error of S' and of S_max
+    data = np.loadtxt(file)
+
+    return data[:, [0, 1, 4]]
+
+def load(n):
+
+    if os.path.exists('n%d_summary.txt' % n):
+        return get_summary('n%d_summary.txt' % n)
+
+    return get_data('n%d.txt' % n)
+
+
+n_1000 = load(1000)
+n_10000 = load(10000)
+n_100000 = load(100000)
+n_1000000 = load(1000000)
 
 Smean_c1 = [np.squeeze(n_1000[np.where(n_1000[:,0]==1),1]), 
            np.squeeze(n_10000[np.where(n_10000[:,0]==1),1]),
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "rng.h"
+
+
+void rng_jump_poly(struct Rng *rng, const uint64_t *jump);
+
+
+void rng_seed(struct Rng *rng, uint64_t seed){
+    /*
+    fills the state with the splitmix64 sequence starting from the seed,
+    which is never all zeros
+    */
+
+    for(int i=0; i<4; i++){
+
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+
+        z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+
+void rng_jump(struct Rng *rng){
+    /*
+    advances the generator by 2^128 steps
+    */
+
+    static const uint64_t jump[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+
+    rng_jump_poly(rng, jump);
+}
+
+
+void rng_long_jump(struct Rng *rng){
+    /*
+    advances the generator by 2^192 steps
+    */
+
+    static const uint64_t jump[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+
+    rng_jump_poly(rng, jump);
+}
+
+
+uint64_t rng_below(struct Rng *rng, uint64_t n){
+    /*
+    the high 64 bits of x*n, with x uniform in [0,2^64), are uniform in
+    [0,n) once the 2^64 mod n values of x giving low bits below 2^64 mod n
+    are rejected
+    */
+
+    unsigned __int128 m = (unsigned __int128) rng_next(rng)*n;
+    uint64_t low = (uint64_t) m;
+
+    // 2^64 mod n < n, so most of the times it is not even needed
+    if(low < n){
+
+        uint64_t threshold = -n % n;
+
+        while(low < threshold){
+            m = (unsigned __int128) rng_next(rng)*n;
+            low = (uint64_t) m;
+        }
+    }
+
+    return (uint64_t) (m >> 64);
+}
+
+
+void rng_fill_below(struct Rng *rng, uint32_t n, uint32_t *out, size_t count){
+    /*
+    same as 'rng_below' with 32 bits numbers, in three passes over the
+    buffer: drawing the numbers, counting the ones to reject and mapping
+    them to [0,n)
+    */
+
+    uint32_t threshold = -n % n; // 2^32 mod n
+    size_t rejected = 0;
+    size_t i;
+
+    for(i=0; i+1<count; i+=2){
+
+        uint64_t r = rng_next(rng);
+
+        out[i] = (uint32_t) r;
+        out[i+1] = (uint32_t) (r >> 32);
+    }
+
+    if(i < count) out[i] = (uint32_t) rng_next(rng);
+
+    for(i=0; i<count; i++){
+        rejected += (uint32_t) ((uint64_t) out[i]*n) < threshold;
+    }
+
+    // about count*n/2^32 numbers, drawn again in the same order every time
+    if(rejected > 0){
+        for(i=0; i<count; i++){
+            while((uint32_t) ((uint64_t) out[i]*n) < threshold){
+                out[i] = (uint32_t) rng_next(rng);
+            }
+        }
+    }
+
+    for(i=0; i<count; i++){
+        out[i] = (uint32_t) (((uint64_t) out[i]*n) >> 32);
+    }
+}
+
+
+void rng_jump_poly(struct Rng *rng, const uint64_t *jump){
+    /*
+    the state after a jump is a linear function of the current one,
+    i.e. the xor of the states met in the next 256 steps selected by the
+    bits of the jump polynomial
+    */
+
+    uint64_t s[4] = {0, 0, 0, 0};
+
+    for(int i=0; i<4; i++){
+        for(int b=0; b<64; b++){
+
+            if(jump[i] & (1ULL << b)){
+                for(int j=0; j<4; j++){
+                    s[j] ^= rng->s[j];
+                }
+            }
+
+            rng_next(rng);
+        }
+    }
+
+    for(int j=0; j<4; j++){
+        rng->s[j] = s[j];
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef __RNG__H
+#define __RNG__H
+#include <stddef.h>
+#include <stdint.h>
+
+
+// random number generator xoshiro256++ (Blackman, Vigna), of period
+// 2^256-1, whose state belongs to the caller instead of being global as
+// the one of rand(), so every thread can use a generator of its own
+struct Rng{
+    uint64_t s[4];
+};
+
+
+    /*
+    initializes the generator from a seed, the 256 bits of the state
+    being generated by splitmix64 so similar seeds give unrelated states
+    */
+void rng_seed(struct Rng *rng, uint64_t seed);
+
+
+    /*
+    advances the generator by 2^128 numbers: starting from the same seed
+    and jumping k times gives a stream of 2^128 numbers not overlapping
+    with the ones of any other k, e.g. one independent stream per measure
+    */
+void rng_jump(struct Rng *rng);
+
+
+    /*
+    advances the generator by 2^192 numbers: starting from the same seed
+    and long jumping k times gives a subspace of 2^192 numbers, i.e. of
+    2^64 streams of 'rng_jump', not overlapping with the ones of any other
+    k, e.g. one subspace per measure split into a stream per chunk of links
+    */
+void rng_long_jump(struct Rng *rng);
+
+
+    /*
+    returns the next random 64 bits integer
+    */
+static inline uint64_t rng_next(struct Rng *rng){
+
+    uint64_t *s = rng->s;
+    uint64_t result = s[0] + s[3];
+    uint64_t t = s[1] << 17;
+
+    result = ((result << 23) | (result >> 41)) + s[0];
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+
+    return result;
+}
+
+
+    /*
+    returns a random integer in [0,n), n > 0, every value having the same
+    probability (Lemire's multiply and reject instead of a biased modulo)
+    */
+uint64_t rng_below(struct Rng *rng, uint64_t n);
+
+
+    /*
+    fills out[0],...,out[count-1] with random integers in [0,n), n > 0,
+    with the same distribution of 'rng_below' but two of them from every
+    64 bits generated: the numbers are drawn first and then mapped to [0,n)
+    together by loops the compiler can vectorize, only the rare ones that
+    would make the distribution uneven being drawn again
+    */
+void rng_fill_below(struct Rng *rng, uint32_t n, uint32_t *out, size_t count);
+#endif
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "stats.h"
+
+
+void stat_reset(struct RunningStat *st){
+    /*
+    series without values
+    */
+
+    st->count = 0;
+    st->mean = 0;
+    st->m2 = 0;
+}
+
+
+void stat_add(struct RunningStat *st, double x){
+    /*
+    the mean moves by (x-mean)/count and m2 grows by the product of
+    the differences of x from the old and the new mean
+    */
+
+    double delta = x - st->mean;
+
+    st->count++;
+    st->mean += delta/st->count;
+    st->m2 += delta*(x - st->mean);
+}
+
+
+void stat_merge(struct RunningStat *st, const struct RunningStat *other){
+    /*
+    the means are weighted by the counts, and m2 grows by the
+    ones of the other series and of the difference of the means
+    */
+
+    if(other->count == 0) return;
+
+    if(st->count == 0){
+        *st = *other;
+        return;
+    }
+
+    double count = (double) st->count + other->count;
+    double delta = other->mean - st->mean;
+
+    st->mean += delta*other->count/count;
+    st->m2 += other->m2 + delta*delta*st->count*other->count/count;
+    st->count += other->count;
+}
+
+
+double stat_variance(const struct RunningStat *st){
+    /*
+    sample variance, with count-1 degrees of freedom
+    */
+
+    if(st->count < 2) return 0;
+
+    return st->m2/(st->count - 1);
+}
+
+
+double stat_error(const struct RunningStat *st){
+    /*
+    the mean of count values has the variance of one of them over count
+    */
+
+    if(st->count == 0) return 0;
+
+    return sqrt(stat_variance(st)/st->count);
+}
@@ -0,0 +1,45 @@
+#ifndef __STATS__H
+#define __STATS__H
+
+
+// mean and variance of a series of values updated one value at a time
+// (Welford), without keeping the values nor summing their squares, whose
+// difference from the square of the sum would lose most of the digits
+struct RunningStat{
+    unsigned long long int count; // values added
+    double mean; // mean of the values
+    double m2; // sum of the squares of the differences from the mean
+};
+
+
+    /*
+    empties the series
+    */
+void stat_reset(struct RunningStat *st);
+
+
+    /*
+    adds the value x to the series
+    */
+void stat_add(struct RunningStat *st, double x);
+
+
+    /*
+    adds all the values of the series 'other' to the series 'st' (Chan),
+    e.g. to join the series of different threads; the result depends
+    (by rounding only) on the order of the merges
+    */
+void stat_merge(struct RunningStat *st, const struct RunningStat *other);
+
+
+    /*
+    returns the (unbiased) variance of the values, 0 with less than 2 values
+    */
+double stat_variance(const struct RunningStat *st);
+
+
+    /*
+    returns the standard error of the mean of the values
+    */
+double stat_error(const struct RunningStat *st);
+#endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "union_find.h"
+
+
+int uf_init(struct UnionFind *uf, unsigned long long int n){
+    /*
+    allocates the components of a graph of n nodes, every node
+    being a component of its own
+
+    returns 0 if the components were allocated succesfully
+    returns -1 otherwise
+    */
+
+    uf->parent = NULL;
+    uf->n = 0;
+
+    if(n == 0 || n > (unsigned long long int) UF_MAX_NODES) return -1;
+
+    uf->parent = malloc(sizeof(uf_index)*n);
+
+    if(uf->parent == NULL) return -1;
+
+    uf->n = (uf_index) n;
+    uf_reset(uf);
+
+    return 0;
+}
+
+
+void uf_reset(struct UnionFind *uf){
+    /*
+    at the beginning every separate node is a single
+    connected component of size 1
+    */
+
+    for(uf_index i=0; i<uf->n; i++){
+        uf->parent[i] = -1;
+    }
+}
+
+
+void uf_free(struct UnionFind *uf){
+    /*
+    deallocates the components
+    */
+
+    free(uf->parent);
+    uf->parent = NULL;
+    uf->n = 0;
+}
+
+
+uf_index uf_find(struct UnionFind *uf, uf_index i){
+    /*
+    returns the connected component a certain node belongs to,
+    linking every other node of the path to the root to its grandparent
+    so the following lookups take about half the steps
+    */
+
+    uf_index *parent = uf->parent;
+
+    while(parent[i] >= 0){
+
+        uf_index p = parent[i];
+
+        if(parent[p] < 0) return p;
+
+        parent[i] = parent[p];
+        i = parent[p];
+    }
+
+    return i;
+}
+
+
+uf_index uf_size(const struct UnionFind *uf, uf_index r){
+    /*
+    size of the component of root r
+    */
+
+    return -uf->parent[r];
+}
+
+
+uf_index uf_link(struct UnionFind *uf, uf_index r1, uf_index r2){
+    /*
+    merges the smallest cluster into the largest
+    */
+
+    uf_index *parent = uf->parent;
+
+    // sizes are negative, so the larger component has the smaller value
+    if(parent[r1] > parent[r2]){
+        parent[r2] += parent[r1];
+        parent[r1] = r2;
+        return -parent[r2];
+    }
+    else{
+        parent[r1] += parent[r2];
+        parent[r2] = r1;
+        return -parent[r1];
+    }
+}
+
+
+uf_index uf_find_atomic(struct UnionFind *uf, uf_index i){
+    /*
+    path splitting: every node of the path is linked to its grandparent
+    (if nobody changed it meanwhile) while moving to its parent
+
+    the loads need no ordering, as a node only ever moves to a node of
+    larger index of the same component: an old value is still a node of
+    the path, and the root is checked again by the swap linking it
+    */
+
+    uf_index *parent = uf->parent;
+    uf_index p = __atomic_load_n(parent + i, __ATOMIC_RELAXED);
+
+    while(p >= 0){
+
+        uf_index g = __atomic_load_n(parent + p, __ATOMIC_RELAXED);
+
+        if(g < 0) return p;
+
+        // a failed swap stores the current parent of i in 'expected',
+        // p must stay the parent read so the walk goes on from it
+        uf_index expected = p;
+
+        __atomic_compare_exchange_n(parent + i, &expected, g, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+        i = p;
+        p = g;
+    }
+
+    return i;
+}
+
+
+int uf_union_atomic(struct UnionFind *uf, uf_index i, uf_index j){
+    /*
+    linking by index instead of by size: with the nodes numbered at random
+    (as the ones of a random graph) the trees stay as shallow, and a root
+    never has to be compared with a size changing under it
+    */
+
+    uf_index *parent = uf->parent;
+
+    for(;;){
+
+        uf_index r1 = uf_find_atomic(uf, i);
+        uf_index r2 = uf_find_atomic(uf, j);
+
+        if(r1 == r2) return 0;
+
+        if(r1 > r2){
+            uf_index temp = r1;
+            r1 = r2;
+            r2 = temp;
+        }
+
+        // r1 is linked only if it is still a root of the size read
+        uf_index size1 = __atomic_load_n(parent + r1, __ATOMIC_ACQUIRE);
+
+        if(size1 >= 0 || !__atomic_compare_exchange_n(parent + r1, &size1, r2, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) continue;
+
+        // the size of r1 goes to the root of r2, following it if
+        // r2 is being linked to another node in the meantime
+        for(;;){
+
+            uf_index size2 = __atomic_load_n(parent + r2, __ATOMIC_ACQUIRE);
+
+            if(size2 >= 0){
+                r2 = size2;
+                continue;
+            }
+
+            if(__atomic_compare_exchange_n(parent + r2, &size2, size2 + size1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+        }
+
+        return 1;
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef __UNION_FIND__H
+#define __UNION_FIND__H
+#include <stdint.h>
+
+
+// index of a node, 32 bits unless compiled with -DUF_INDEX64,
+// which is needed for graphs of 2^31 nodes or more
+#ifdef UF_INDEX64
+typedef int64_t uf_index;
+#define UF_MAX_NODES INT64_MAX
+#else
+typedef int32_t uf_index;
+#define UF_MAX_NODES INT32_MAX
+#endif
+
+
+// connected components of a graph of n nodes (disjoint set forest)
+//
+// every node keeps only the index of its parent, the root of a
+// component keeping instead its size as a negative number: with 32 bits
+// indices a node takes 4 bytes instead of the 16 of a pointer and a size
+struct UnionFind{
+    uf_index *parent; // parent of every node, -size for the roots
+    uf_index n; // number of nodes
+};
+
+
+    /*
+    allocates the components of a graph of n nodes, every node being
+    a component of its own
+
+    returns 0 if the components were allocated succesfully
+    returns -1 if n is too large for the indices or the allocation failed
+    */
+int uf_init(struct UnionFind *uf, unsigned long long int n);
+
+
+    /*
+    makes again every node a component of its own, for a new graph
+    */
+void uf_reset(struct UnionFind *uf);
+
+
+    /*
+    deallocates the components
+    */
+void uf_free(struct UnionFind *uf);
+
+
+    /*
+    returns the root of the component of node i, halving the path
+    to it (every node on the path is linked to its grandparent)
+    */
+uf_index uf_find(struct UnionFind *uf, uf_index i);
+
+
+    /*
+    returns the size of the component of root r
+    */
+uf_index uf_size(const struct UnionFind *uf, uf_index r);
+
+
+    /*
+    merges the components of roots r1 != r2, the smaller one
+    being linked to the larger one
+
+    returns the size of the merged component
+    */
+uf_index uf_link(struct UnionFind *uf, uf_index r1, uf_index r2);
+
+
+    /*
+    same as 'uf_find' for components shared by many threads adding links
+    at the same time ('uf_union_atomic'): the path is split (every node on
+    it linked to its grandparent) by compare-and-swap, which may fail with
+    no harm if another thread changed the node meanwhile, so the lookup
+    never waits for the other threads
+
+    the root returned may have been linked to another node by the time
+    it is used
+    */
+uf_index uf_find_atomic(struct UnionFind *uf, uf_index i);
+
+
+    /*
+    merges the components of nodes i and j while other threads may do the
+    same on the same components: the root of smaller index is linked to
+    the other one by compare-and-swap, retrying from the lookups if the
+    root was changed meanwhile, and its size is then added to the root of
+    the merged component
+
+    as the links always go to a larger index there are no cycles, and a
+    link is never lost; when all the threads are done every root stores
+    the exact size of its component, as after 'uf_link' (the order of the
+    links decides the shape of the trees, not the components)
+
+    returns 1 if the components were merged
+    returns 0 if the nodes were already in the same component
+    */
+int uf_union_atomic(struct UnionFind *uf, uf_index i, uf_index j);
+
+
+    /*
+    asks the processor to load the entry of node i, and the one of its
+    parent if i is not a root, ahead of a lookup of i: the entries of large
+    graphs are far apart in memory, so the loads of a few following lookups
+    overlap instead of waiting one after the other; the components are not
+    changed, the lookups giving the same results with or without the hints
+    */
+static inline void uf_prefetch(const struct UnionFind *uf, uf_index i){
+    __builtin_prefetch(uf->parent + i, 1);
+}
+
+static inline void uf_prefetch_parent(const struct UnionFind *uf, uf_index i){
+
+    uf_index p = uf->parent[i];
+
+    if(p >= 0) __builtin_prefetch(uf->parent + p, 1);
+}
+#endif